@@ -0,0 +1,72 @@
+/*
+Author: Assem Samy
+File: arena.c
+Comment: Block arena allocator used for per-line tokenizer storage
+*/
+
+/*-----------------Includes Section--------------*/
+#include "arena.h"
+#include <stdlib.h>
+
+/*-----------Section Contains Function Definitions------------*/
+
+void arena_init(Arena *arena) {
+    arena->head = NULL;
+}
+
+/* Hand out 'size' bytes that stay valid until the next arena_reset.
+ * Pointers never move: a full block is chained, never reallocated.
+ */
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    ArenaBlock *block = arena->head;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(ArenaBlock) + block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->size = block_size;
+        block->used = 0;
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+/* Drop everything allocated so far.
+ * The largest block is kept so a steady workload stops calling malloc after the first line.
+ */
+void arena_reset(Arena *arena) {
+    ArenaBlock *keep = NULL;
+    ArenaBlock *block = arena->head;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        if (keep == NULL || block->size > keep->size) {
+            free(keep);
+            keep = block;
+        } else {
+            free(block);
+        }
+        block = next;
+    }
+    if (keep != NULL) {
+        keep->used = 0;
+        keep->next = NULL;
+    }
+    arena->head = keep;
+}
+
+void arena_free(Arena *arena) {
+    ArenaBlock *block = arena->head;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
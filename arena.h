@@ -0,0 +1,30 @@
+/*
+Author: Assem Samy
+File: arena.h
+Comment: Block arena allocator, memory handed out is released all at once with arena_reset
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+/*-----------------includes section--------------*/
+#include <stddef.h>
+/*----------------macros declarations-----------------*/
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGN      16
+/*-----------------types declarations-----------------*/
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;   // Block currently being filled
+} Arena;
+/*-----------section contains functions declarations------------*/
+void arena_init(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+#endif
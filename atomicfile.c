@@ -0,0 +1,378 @@
+/*
+Author: Assem Samy
+File: atomicfile.c
+Comment: Atomic replace for mycp/mymv, O_TMPFILE + linkat + rename, with per-file or batched (syncfs) durability
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "atomicfile.h"
+#include "trace.h"
+#include <sys/xattr.h>
+
+/*-----------------variables and static functions---------------*/
+static unsigned int temp_counter;   // Makes temporary names unique within this process
+
+/* ".name.mycp-<pid>-<n>": hidden, and next to the target so the rename stays on one file system */
+static char *make_temp_name(const char *name) {
+    unsigned int n = __atomic_add_fetch(&temp_counter, 1, __ATOMIC_RELAXED);
+    size_t len = strlen(name) + 40;
+    char *temp = malloc(len);
+    if (temp != NULL) {
+        snprintf(temp, len, ".%s.mycp-%d-%u", name, (int)getpid(), n);
+    }
+    return temp;
+}
+
+/* Give the unnamed O_TMPFILE inode a name. AT_EMPTY_PATH needs CAP_DAC_READ_SEARCH,
+ * the /proc/self/fd link works for everyone */
+static int link_anonymous(AtomicFile *af, const char *name) {
+    if (linkat(af->fd, "", af->dir_fd, name, AT_EMPTY_PATH) == 0) {
+        return 0;
+    }
+    if (errno == EEXIST) {
+        return -1;
+    }
+    char proc_path[64];
+    snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", af->fd);
+    return linkat(AT_FDCWD, proc_path, af->dir_fd, name, AT_SYMLINK_FOLLOW);
+}
+
+/* Make sure the new file has a temporary name in dir_fd (not the final one) */
+static int name_temp(AtomicFile *af) {
+    if (!af->anonymous) {
+        return 0;
+    }
+    for (int attempt = 0; attempt < 100; attempt++) {
+        char *temp = make_temp_name(af->name);
+        if (temp == NULL) {
+            return -1;
+        }
+        if (link_anonymous(af, temp) == 0) {
+            af->temp_name = temp;
+            af->anonymous = 0;
+            return 0;
+        }
+        free(temp);
+        if (errno != EEXIST) {
+            return -1;
+        }
+    }
+    errno = EEXIST;
+    return -1;
+}
+
+/* Rename 'temp' over 'name', both relative to 'dir_fd'. A target that existed at open is
+ * replaced (flags 0), otherwise RENAME_NOREPLACE keeps a file that appeared meanwhile. File
+ * systems without renameat2 flags get renameat, or link + unlink for a new target.
+ */
+static int rename_over(int dir_fd, const char *temp, const char *name, int existed) {
+    unsigned int flags = existed ? 0 : RENAME_NOREPLACE;
+    if (renameat2(dir_fd, temp, dir_fd, name, flags) == 0) {
+        return 0;
+    }
+    if (errno != EINVAL && errno != ENOSYS) {
+        return -1;
+    }
+    if (existed) {
+        return renameat(dir_fd, temp, dir_fd, name);
+    }
+    if (linkat(dir_fd, temp, dir_fd, name, 0) == -1) {
+        return -1;
+    }
+    unlinkat(dir_fd, temp, 0);
+    return 0;
+}
+
+/* Set every extended attribute of 'path' on 'fd', POSIX ACLs included
+ * (system.posix_acl_access). Returns 0, or -1 with errno set if one could not be copied.
+ */
+static int copy_xattrs(const char *path, int fd) {
+    ssize_t size = listxattr(path, NULL, 0);
+    if (size <= 0) {
+        // ENOTSUP: the file system has no extended attributes, so there are none to keep
+        return (size == -1 && errno != ENOTSUP) ? -1 : 0;
+    }
+    char *names = malloc(size);
+    if (names == NULL) {
+        return -1;
+    }
+    size = listxattr(path, names, size);
+    int rc = size == -1 ? -1 : 0;
+    for (ssize_t offset = 0; rc == 0 && offset < size; offset += strlen(names + offset) + 1) {
+        const char *name = names + offset;
+        ssize_t length = getxattr(path, name, NULL, 0);
+        char *value = length > 0 ? malloc(length) : NULL;
+        if (length == -1 || (length > 0 && value == NULL)) {
+            rc = -1;
+        } else if ((length > 0 && (length = getxattr(path, name, value, length)) == -1) ||
+                   fsetxattr(fd, name, value, length, 0) == -1) {
+            rc = -1;
+        }
+        free(value);
+    }
+    int err = errno;
+    free(names);
+    errno = err;
+    return rc;
+}
+
+static void close_file(AtomicFile *af) {
+    if (af->fd != -1) {
+        close(af->fd);
+    }
+    if (af->dir_fd != -1) {
+        close(af->dir_fd);
+    }
+    free(af->path);
+    free(af->temp_name);
+    af->fd = af->dir_fd = -1;
+    af->path = af->name = af->temp_name = NULL;
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Start replacing 'path'. The new contents go to af->fd, a file in the same directory
+ * that has no name yet (O_TMPFILE), or a hidden temporary name on file systems without
+ * O_TMPFILE. 'path' itself is untouched until atomic_file_commit(), so a crash or an
+ * error leaves either the old file or the new one, never a torn mix.
+ * 'mode' is used as with open(O_CREAT), the umask applies.
+ * Returns 0, or -1 with errno set.
+ */
+int atomic_file_open(AtomicFile *af, const char *path, mode_t mode) {
+    memset(af, 0, sizeof(*af));
+    af->fd = af->dir_fd = -1;
+    af->path = strdup(path);
+    if (af->path == NULL) {
+        return -1;
+    }
+
+    char *slash = strrchr(af->path, '/');
+    if (slash == NULL) {
+        af->name = af->path;
+        af->dir_fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    } else {
+        af->name = slash + 1;
+        *slash = '\0';
+        af->dir_fd = open(slash == af->path ? "/" : af->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        *slash = '/';
+    }
+    if (af->dir_fd == -1 || *af->name == '\0') {
+        if (*af->name == '\0') {
+            errno = EISDIR;
+        }
+        close_file(af);
+        return -1;
+    }
+
+    struct stat st;
+    af->existed = fstatat(af->dir_fd, af->name, &st, AT_SYMLINK_NOFOLLOW) == 0;
+
+    af->fd = openat(af->dir_fd, ".", O_TMPFILE | O_RDWR | O_CLOEXEC, mode);
+    if (af->fd != -1) {
+        af->anonymous = 1;
+        return 0;
+    }
+    // Older kernels and some file systems (NFS, FUSE) have no O_TMPFILE, use a hidden name
+    for (int attempt = 0; attempt < 100 && af->fd == -1; attempt++) {
+        af->temp_name = make_temp_name(af->name);
+        if (af->temp_name == NULL) {
+            break;
+        }
+        af->fd = openat(af->dir_fd, af->temp_name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+        if (af->fd == -1) {
+            int err = errno;
+            free(af->temp_name);
+            af->temp_name = NULL;
+            if (err != EEXIST) {
+                errno = err;
+                break;
+            }
+        }
+    }
+    if (af->fd == -1) {
+        int err = errno;
+        close_file(af);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+/* Give the new file the owner and the extended attributes (ACLs, labels) of 'old', the
+ * file it is about to replace, which an in-place write would have kept. Returns 0, or
+ * -1 with errno set when they cannot all be kept (another owner without root, a
+ * protected attribute): the caller should then write the old file in place instead.
+ */
+int atomic_file_keep(AtomicFile *af, const struct stat *old) {
+    struct stat st;
+
+    if (fstat(af->fd, &st) == -1) {
+        return -1;
+    }
+    // Before any chmod by the caller: chown clears the set-user-ID and set-group-ID bits
+    if ((st.st_uid != old->st_uid || st.st_gid != old->st_gid) && fchown(af->fd, old->st_uid, old->st_gid) == -1) {
+        return -1;
+    }
+    return copy_xattrs(af->path, af->fd);
+}
+
+/* Publish the new file under its target name, replacing any old file in one step.
+ * With ATOMIC_DURABLE_EACH the data is fsync'ed before it gets the name and the
+ * directory after, so the replacement survives a power cut once this returns.
+ * A target that did not exist at open is never replaced, the commit then fails with
+ * EEXIST. af is closed either way. Returns 0, or -1 with errno set (the target is unchanged).
+ */
+int atomic_file_commit(AtomicFile *af, int durability) {
+    int rc = 0;
+
+    if (durability == ATOMIC_DURABLE_EACH && fsync(af->fd) == -1) {
+        rc = -1;
+    }
+    // A new target can be linked straight to its name, which also fails if one appeared meanwhile
+    if (rc == 0 && af->anonymous && !af->existed && link_anonymous(af, af->name) == 0) {
+        af->anonymous = 0;
+    } else if (rc == 0 && !af->existed && af->anonymous && errno == EEXIST) {
+        rc = -1;   // Not there at open, so not ours to replace
+    } else if (rc == 0 && (name_temp(af) == -1 ||
+                           rename_over(af->dir_fd, af->temp_name, af->name, af->existed) == -1)) {
+        rc = -1;
+    } else if (rc == 0) {
+        free(af->temp_name);
+        af->temp_name = NULL;
+    }
+    if (rc == 0 && durability == ATOMIC_DURABLE_EACH && fsync(af->dir_fd) == -1) {
+        rc = -1;
+    }
+
+    int err = errno;
+    if (rc == -1) {
+        atomic_file_abort(af);
+    } else {
+        close_file(af);
+    }
+    errno = err;
+    return rc;
+}
+
+/* Throw the new contents away, the target keeps its old contents */
+void atomic_file_abort(AtomicFile *af) {
+    if (af->temp_name != NULL) {
+        unlinkat(af->dir_fd, af->temp_name, 0);
+    }
+    close_file(af);
+}
+
+void atomic_batch_init(AtomicBatch *batch) {
+    memset(batch, 0, sizeof(*batch));
+    batch->sync_fd = -1;
+}
+
+/* Stage a written file for the batch: it gets a hidden temporary name next to its
+ * target and is closed, nothing is synced yet. A file on another file system than
+ * the batch so far commits the batch first, so is reaching ATOMIC_BATCH_FILES.
+ * af is closed either way. Returns 0, or -1 if staging or a commit failed.
+ */
+int atomic_batch_add(AtomicBatch *batch, AtomicFile *af) {
+    struct stat st;
+    int rc = 0;
+
+    if (fstat(af->dir_fd, &st) == -1 || name_temp(af) == -1) {
+        int err = errno;
+        atomic_file_abort(af);
+        errno = err;
+        return -1;
+    }
+    if (batch->count > 0 && st.st_dev != batch->dev) {
+        rc = atomic_batch_commit(batch);
+    }
+    if (batch->count == batch->capacity) {
+        size_t new_capacity = batch->capacity ? batch->capacity * 2 : 64;
+        AtomicStaged *entries = realloc(batch->entries, new_capacity * sizeof(AtomicStaged));
+        if (entries == NULL) {
+            atomic_file_abort(af);
+            errno = ENOMEM;
+            return -1;
+        }
+        batch->entries = entries;
+        batch->capacity = new_capacity;
+    }
+
+    // Both paths as given, relative ones stay relative to the same working directory
+    size_t dir_len = af->name - af->path;
+    char *temp_path = malloc(dir_len + strlen(af->temp_name) + 1);
+    if (temp_path == NULL) {
+        atomic_file_abort(af);
+        errno = ENOMEM;
+        return -1;
+    }
+    if (batch->count == 0) {
+        // syncfs goes through this descriptor, without it the file is not staged at all (EMFILE)
+        batch->sync_fd = dup(af->dir_fd);
+        if (batch->sync_fd == -1) {
+            int err = errno;
+            free(temp_path);
+            atomic_file_abort(af);
+            errno = err;
+            return -1;
+        }
+        batch->dev = st.st_dev;
+    }
+    memcpy(temp_path, af->path, dir_len);
+    strcpy(temp_path + dir_len, af->temp_name);
+    batch->entries[batch->count].temp_path = temp_path;
+    batch->entries[batch->count].final_path = af->path;
+    batch->entries[batch->count].existed = af->existed;
+    batch->count++;
+
+    af->path = NULL;   // Now owned by the batch
+    close_file(af);
+
+    if (batch->count >= ATOMIC_BATCH_FILES && atomic_batch_commit(batch) == -1) {
+        rc = -1;
+    }
+    return rc;
+}
+
+/* Publish every staged file with two syncs in total instead of two per file:
+ * syncfs makes all the data durable, the renames publish it, and a second syncfs
+ * makes the new names durable. Renaming before the data is on disk could leave
+ * empty files after a crash, which is what the first syncfs rules out. As with
+ * atomic_file_commit(), a target that did not exist when staged is never replaced.
+ * Returns 0, or -1 if anything failed (reported on stderr, the rest is published).
+ */
+int atomic_batch_commit(AtomicBatch *batch) {
+    int rc = 0;
+
+    if (batch->count == 0) {
+        return 0;
+    }
+    int synced = syncfs(batch->sync_fd) == 0;
+    if (!synced) {
+        perror("syncfs");
+        rc = -1;
+    }
+    for (size_t k = 0; k < batch->count; k++) {
+        AtomicStaged *staged = &batch->entries[k];
+        // Unsynced data must not replace good files, so a failed sync publishes nothing
+        if (!synced || rename_over(AT_FDCWD, staged->temp_path, staged->final_path, staged->existed) == -1) {
+            if (synced) {
+                perror(staged->final_path);
+                rc = -1;
+            }
+            unlink(staged->temp_path);
+        }
+        free(staged->temp_path);
+        free(staged->final_path);
+    }
+    if (rc == 0 && syncfs(batch->sync_fd) == -1) {
+        perror("syncfs");
+        rc = -1;
+    }
+    TRACE(TRACE_INFO, "Committed a batch of %zu files (%s)", batch->count, rc == 0 ? "durable" : "failed");
+
+    close(batch->sync_fd);
+    free(batch->entries);
+    atomic_batch_init(batch);
+    return rc;
+}
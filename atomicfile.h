@@ -0,0 +1,52 @@
+/*
+Author: Assem Samy
+File: atomicfile.h
+Comment: Crash-safe file replacement, data goes to an unnamed O_TMPFILE that is linked and renamed over the target
+*/
+
+#ifndef ATOMICFILE_H
+#define ATOMICFILE_H
+/*-----------------includes section--------------*/
+#include <sys/types.h>
+#include <sys/stat.h>
+/*----------------macros declarations-----------------*/
+#define ATOMIC_BATCH_FILES  1024   // Staged files per batch commit, bounds the window of unsynced work
+#define ATOMIC_DURABLE_NONE  0     // Atomic replace only, the data reaches the disk when the kernel writes it back
+#define ATOMIC_DURABLE_EACH  1     // fsync every file before publishing it and its directory after
+#define ATOMIC_DURABLE_BATCH 2     // Stage files under temporary names, one syncfs, rename them all, one syncfs
+/*-----------------types declarations-----------------*/
+typedef struct {
+    int fd;                // Write the new contents here, open for reading too
+    int dir_fd;            // Directory of the target
+    int anonymous;         // O_TMPFILE, not linked anywhere yet
+    int existed;           // The target existed at open, only then may the commit replace one
+    char *path;            // Target path, as given
+    char *name;            // Last component of the target, relative to dir_fd
+    char *temp_name;       // Temporary name in dir_fd once linked, NULL before
+} AtomicFile;
+
+/* One file staged under its temporary name, waiting for the batch commit */
+typedef struct {
+    char *temp_path;
+    char *final_path;
+    int existed;           // As AtomicFile.existed, a target that did not exist is never replaced
+} AtomicStaged;
+
+/* Files published together by atomic_batch_commit(), all on one file system */
+typedef struct {
+    AtomicStaged *entries;
+    size_t count;
+    size_t capacity;
+    int sync_fd;           // A directory on the batch's file system, for syncfs
+    dev_t dev;
+} AtomicBatch;
+/*-----------section contains functions declarations------------*/
+int atomic_file_open(AtomicFile *af, const char *path, mode_t mode);
+int atomic_file_keep(AtomicFile *af, const struct stat *old);
+int atomic_file_commit(AtomicFile *af, int durability);
+void atomic_file_abort(AtomicFile *af);
+
+void atomic_batch_init(AtomicBatch *batch);
+int atomic_batch_add(AtomicBatch *batch, AtomicFile *af);
+int atomic_batch_commit(AtomicBatch *batch);
+#endif
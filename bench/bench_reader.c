@@ -0,0 +1,97 @@
+/*
+Author: Assem Samy
+File: bench/bench_reader.c
+Comment: Lines-per-second benchmark, old 100-byte read() loop against the buffered LineReader
+Build: gcc -O2 -I. bench/bench_reader.c reader.c -o bench_reader.out
+Usage: ./bench_reader.out [lines]
+*/
+
+/*-----------------Includes Section--------------*/
+#include "reader.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*-----------------static functions---------------*/
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Write a script of 'lines' short commands to a temporary file and return its descriptor */
+static int make_script(long lines) {
+    char path[] = "/tmp/bench_reader_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        perror("mkstemp");
+        exit(EXIT_FAILURE);
+    }
+    unlink(path);
+
+    FILE *out = fdopen(dup(fd), "w");
+    for (long i = 0; i < lines; i++) {
+        fprintf(out, "myecho line %ld with a few arguments\n", i);
+    }
+    fclose(out);
+    return fd;
+}
+
+/* The loop used by main() before the LineReader: one read() per command, strtok over the chunk */
+static long legacy_loop(int fd) {
+    char command[100];
+    long commands = 0;
+    ssize_t readsize;
+
+    lseek(fd, 0, SEEK_SET);
+    while ((readsize = read(fd, command, sizeof(command) - 1)) > 0) {
+        command[readsize] = '\0';
+        char *tok = strtok(command, " \n");
+        while (tok != NULL) {
+            tok = strtok(NULL, " \n");
+        }
+        commands++;
+    }
+    return commands;
+}
+
+static long reader_loop(int fd) {
+    LineReader reader;
+    char *line;
+    long lines = 0;
+
+    lseek(fd, 0, SEEK_SET);
+    line_reader_init(&reader, fd);
+    while (line_reader_next(&reader, &line) >= 0) {
+        char *tok = strtok(line, " ");
+        while (tok != NULL) {
+            tok = strtok(NULL, " ");
+        }
+        lines++;
+    }
+    line_reader_free(&reader);
+    return lines;
+}
+
+int main(int argc, char *argv[]) {
+    long lines = (argc > 1) ? atol(argv[1]) : 1000000;
+    int fd = make_script(lines);
+
+    double t0 = now_seconds();
+    long legacy = legacy_loop(fd);
+    double t1 = now_seconds();
+    long buffered = reader_loop(fd);
+    double t2 = now_seconds();
+
+    printf("input lines:        %ld\n", lines);
+    printf("legacy read loop:   %ld commands seen (%ld lines merged or cut), %.0f lines/s\n",
+           legacy, labs(lines - legacy), lines / (t1 - t0));
+    printf("buffered reader:    %ld commands seen, %.0f lines/s\n",
+           buffered, buffered / (t2 - t1));
+
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+Author: Assem Samy
+File: bench/bench_scan.c
+Comment: Directory listing cost: readdir + lstat per entry (the old myls -i) against the getdents64 entry store and its statx stage
+Build: gcc -O2 -I. bench/bench_scan.c entrystore.c trace.c -pthread -o bench_scan.out
+Usage: ./bench_scan.out [entries] [dir]     (default: 1000000 entries in /tmp, the directory is removed after)
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "entrystore.h"
+
+/*-----------------static functions---------------*/
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* What myls did before the entry store: readdir, and with 'with_stat' an lstat by full path */
+static double scan_readdir(const char *dir, int with_stat, long *count) {
+    double start = now_seconds();
+    DIR *dp = opendir(dir);
+    struct dirent *entry;
+    char path[PATH_MAX];
+    struct stat st;
+
+    *count = 0;
+    while ((entry = readdir(dp)) != NULL) {
+        if (with_stat) {
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            if (lstat(path, &st) == -1) {
+                continue;
+            }
+        }
+        (*count)++;
+    }
+    closedir(dp);
+    return now_seconds() - start;
+}
+
+/* getdents64 into the store, then with 'types' an fstatat for each entry the file system
+ * left DT_UNKNOWN, or with a 'mask' or 'time_field' the statx stage */
+static double scan_store(const char *dir, int types, unsigned int mask, char time_field, long *count) {
+    EntryStore store;
+
+    double start = now_seconds();
+    entry_store_init(&store);
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (dir_fd == -1 || entry_store_scan(&store, dir_fd, ENTRY_LOAD_DOTS) == -1) {
+        perror(dir);
+        exit(EXIT_FAILURE);
+    }
+    for (size_t k = 0; types && k < store.count; k++) {
+        struct stat st;
+        DirEntry *entry = &store.entries[k];
+        if (entry->type == DT_UNKNOWN && fstatat(dir_fd, entry_name(&store, entry), &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            entry->type = IFTODT(st.st_mode);
+        }
+    }
+    if (mask != 0 || time_field != 0) {
+        if (entry_store_stat(&store, dir_fd, mask, time_field) == -1) {
+            perror("entry_store_stat");
+            exit(EXIT_FAILURE);
+        }
+    }
+    close(dir_fd);
+    *count = store.count;
+    entry_store_free(&store);
+    return now_seconds() - start;
+}
+
+static void report(const char *label, double elapsed, long count) {
+    printf("%-28s %8.3f s  %10.0f entries/s  (%ld)\n", label, elapsed, count / elapsed, count);
+}
+
+int main(int argc, char *argv[]) {
+    long entries = (argc > 1) ? atol(argv[1]) : 1000000;
+    const char *parent = (argc > 2) ? argv[2] : "/tmp";
+    char dir[PATH_MAX];
+    char name[32];
+    long count;
+
+    snprintf(dir, sizeof(dir), "%s/bench_scan.d", parent);
+    if (mkdir(dir, 0755) == -1) {
+        perror(dir);
+        return 1;
+    }
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+    double start = now_seconds();
+    for (long k = 0; k < entries; k++) {
+        snprintf(name, sizeof(name), "entry-%09ld", k);
+        int fd = openat(dir_fd, name, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd == -1) {
+            perror(name);
+            return 1;
+        }
+        close(fd);
+    }
+    printf("created %ld entries in %.1f s\n", entries, now_seconds() - start);
+
+    scan_readdir(dir, 1, &count);   // Warm the dentry and inode caches for every run
+    report("readdir + lstat", scan_readdir(dir, 1, &count), count);
+    report("readdir, names only", scan_readdir(dir, 0, &count), count);
+    report("getdents64 store", scan_store(dir, 0, 0, 0, &count), count);
+    report("getdents64 store + types", scan_store(dir, 1, 0, 0, &count), count);
+    report("store + statx mtime (-t)", scan_store(dir, 0, 0, 'm', &count), count);
+    report("store + statx -l fields", scan_store(dir, 0, STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID |
+                                                 STATX_GID | STATX_SIZE, 'm', &count), count);
+
+    for (long k = 0; k < entries; k++) {
+        snprintf(name, sizeof(name), "entry-%09ld", k);
+        unlinkat(dir_fd, name, 0);
+    }
+    close(dir_fd);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*
+Author: Assem Samy
+File: bench/bench_spawn.c
+Comment: Launch latency of fork()+execve against launch_process (posix_spawn) at several shell RSS sizes
+Build: gcc -O2 -I. bench/bench_spawn.c launch.c -o bench_spawn.out
+Usage: ./bench_spawn.out [iterations] [rss_mb ...]     (default: 200 iterations at 0 64 256 1024 MB)
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "launch.h"
+
+/*-----------------static functions---------------*/
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double fork_latency(const char *path, char **argv, int iterations) {
+    double start = now_seconds();
+    for (int i = 0; i < iterations; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            execve(path, argv, environ);
+            _exit(127);
+        }
+        waitpid(pid, NULL, 0);
+    }
+    return (now_seconds() - start) / iterations;
+}
+
+static double spawn_latency(const char *path, char **argv, int iterations) {
+    double start = now_seconds();
+    for (int i = 0; i < iterations; i++) {
+        pid_t pid = launch_process(path, argv, NULL);
+        waitpid(pid, NULL, 0);
+    }
+    return (now_seconds() - start) / iterations;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = (argc > 1) ? atoi(argv[1]) : 200;
+    long default_sizes[] = {0, 64, 256, 1024};
+    int size_count = (argc > 2) ? argc - 2 : 4;
+    char *child_argv[] = {"true", NULL};
+    const char *path = "/bin/true";
+
+    printf("%10s %14s %14s %8s\n", "rss_mb", "fork_us", "spawn_us", "speedup");
+    for (int s = 0; s < size_count; s++) {
+        long mb = (argc > 2) ? atol(argv[s + 2]) : default_sizes[s];
+        size_t bytes = (size_t)mb << 20;
+        char *ballast = NULL;
+
+        // Touch every page so the memory is really resident in the shell-like parent
+        if (bytes > 0) {
+            ballast = malloc(bytes);
+            if (ballast == NULL) {
+                perror("malloc");
+                return 1;
+            }
+            memset(ballast, 1, bytes);
+        }
+
+        double f = fork_latency(path, child_argv, iterations);
+        double p = spawn_latency(path, child_argv, iterations);
+        printf("%10ld %14.1f %14.1f %7.1fx\n", mb, f * 1e6, p * 1e6, f / p);
+
+        free(ballast);
+    }
+    return 0;
+}
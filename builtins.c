@@ -0,0 +1,653 @@
+/*
+Author: Assem Samy
+File: builtins.c
+Comment: Builtin handlers and the perfect-hash registry used to dispatch them
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "builtins.h"
+#include "pathcache.h"
+#include "idcache.h"
+#include "pipeline.h"
+#include "trace.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "timing.h"
+#include "copytree.h"
+#include "uringcopy.h"
+#include "removetree.h"
+
+/*-----------------builtin handlers---------------*/
+
+static int builtin_mypwd(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    char buff[PATH_MAX];  //for getcwd
+    char *retval = getcwd(buff, PATH_MAX);
+    if (retval == NULL) {
+        perror("getcwd");
+        exit(EXIT_FAILURE);
+    }
+    printf("%s\n", retval);
+    return 0;
+}
+
+static int builtin_myecho(int argc, char **argv) {
+    echo_command(argc, argv);
+    return 0;
+}
+
+static int builtin_mycp(int argc, char **argv) {
+    CopyOptions opts;
+    int recursive = 0;
+    int verbose = 0;
+    int uring = 0;
+    const char *manifest_path = NULL;
+    int source_index = 1;
+    int destination_index = argc - 1;
+
+    copy_options_init(&opts);
+
+    // Check for the -a, -r, -u, -d, -v, -V, -U, -s, -S, -g, -D, -j N and -m file options, alone or together as -ru
+    while (source_index < argc && argv[source_index][0] == '-' && argv[source_index][1] != '\0') {
+        for (const char *opt = argv[source_index] + 1; *opt != '\0'; opt++) {
+            if (*opt == 'a') {
+                opts.append = 1;
+            } else if (*opt == 'r') {
+                recursive = 1;
+            } else if (*opt == 'g') {
+                opts.progress = 1;
+            } else if (*opt == 'D') {
+                opts.direct = 1;
+            } else if (*opt == 's') {
+                opts.durability = ATOMIC_DURABLE_EACH;
+            } else if (*opt == 'S') {
+                opts.durability = ATOMIC_DURABLE_BATCH;
+            } else if (*opt == 'u') {
+                opts.update = opts.update ? opts.update : COPY_UPDATE_QUICK;
+            } else if (*opt == 'd') {
+                opts.update = COPY_UPDATE_DELTA;
+            } else if (*opt == 'v') {
+                opts.verify = 1;
+            } else if (*opt == 'V') {
+                verbose = 1;
+            } else if (*opt == 'U') {
+                uring = 1;
+            } else if (*opt == 'm') {
+                // Manifest file, either attached (-mSUMS) or the next argument (-m SUMS); implies -v
+                manifest_path = opt[1] != '\0' ? opt + 1 : argv[++source_index];
+                if (source_index >= argc) {
+                    fprintf(stderr, "mycp: -m needs a manifest file\n");
+                    return 1;
+                }
+                opts.verify = 1;
+                break;
+            } else if (*opt == 'j') {
+                // Thread count, either attached (-j8) or the next argument (-j 8)
+                const char *value = opt[1] != '\0' ? opt + 1 : argv[++source_index];
+                if (source_index >= argc || (opts.threads = atoi(value)) <= 0) {
+                    fprintf(stderr, "mycp: -j needs a thread count\n");
+                    return 1;
+                }
+                break;
+            } else {
+                fprintf(stderr, "mycp: unknown option -%c\n", *opt);
+                return 1;
+            }
+        }
+        source_index++;
+    }
+    if (destination_index <= source_index) {
+        fprintf(stderr, "error: cp [-a] [-r] [-u] [-d] [-v] [-V] [-U] [-s|-S] [-g] [-D] [-m manifest] [-j threads] <source>... <destination>\n");
+        return 1;
+    }
+    if (opts.append && recursive) {
+        fprintf(stderr, "mycp: -a cannot be used with -r\n");
+        return 1;
+    }
+    if (opts.verify && recursive) {
+        fprintf(stderr, "mycp: -v and -m cannot be used with -r\n");
+        return 1;
+    }
+    if (opts.update != COPY_UPDATE_NONE && opts.append) {
+        fprintf(stderr, "mycp: -u and -d cannot be used with -a\n");
+        return 1;
+    }
+    if (opts.update == COPY_UPDATE_DELTA && opts.verify) {
+        fprintf(stderr, "mycp: -d cannot be used with -v\n");
+        return 1;
+    }
+    if (opts.progress && recursive) {
+        fprintf(stderr, "mycp: -g cannot be used with -r\n");
+        return 1;
+    }
+    if (uring && recursive) {
+        fprintf(stderr, "mycp: -U cannot be used with -r\n");
+        return 1;
+    }
+    if (verbose && recursive) {
+        fprintf(stderr, "mycp: -V cannot be used with -r\n");
+        return 1;
+    }
+    if (opts.durability != ATOMIC_DURABLE_NONE && recursive) {
+        fprintf(stderr, "mycp: -s and -S cannot be used with -r\n");
+        return 1;
+    }
+
+    const char *destination = argv[destination_index];
+    if (recursive) {
+        // Every source goes through the worker pool, errors are per entry and do not stop the copy
+        CopyTreeStats stats;
+        int status = 0;
+        memset(&stats, 0, sizeof(stats));
+        for (; source_index < destination_index; source_index++) {
+            if (copy_tree(argv[source_index], destination, &opts, &stats) == -1) {
+                status = 1;
+            }
+            if (stats.failed != 0) {
+                fprintf(stderr, "mycp: %s: copy stopped: %s\n", argv[source_index], strerror(stats.failed));
+                break;
+            }
+        }
+        if (opts.update != COPY_UPDATE_NONE) {
+            printf("%ld copied, %ld unchanged, %lld bytes written\n", stats.files, stats.unchanged,
+                   (long long)stats.bytes);
+        }
+        return status;
+    }
+
+    // Into an existing directory every source keeps its name, as with cp
+    struct stat dst_st;
+    int into_dir = stat(destination, &dst_st) == 0 && S_ISDIR(dst_st.st_mode);
+    int count = destination_index - source_index;
+    char **sources = &argv[source_index];
+    int status = 0;
+    char *done = calloc(count, 1);
+    if (done == NULL) {
+        perror("malloc failed");
+        return 1;
+    }
+    AtomicBatch batch;
+    atomic_batch_init(&batch);
+    FILE *manifest = NULL;
+    if (manifest_path != NULL && (manifest = fopen(manifest_path, "a")) == NULL) {
+        perror(manifest_path);
+        free(done);
+        return 1;
+    }
+
+    // -U, many sources into a directory: small files go through one io_uring batch first.
+    // Opt-in, it only beats the loop below where the kernel runs openat and close inline
+    if (uring && into_dir && !verbose && !opts.append && !opts.verify && !opts.progress &&
+        opts.update == COPY_UPDATE_NONE && opts.durability == ATOMIC_DURABLE_NONE && opts.threads == 1 &&
+        count >= URING_COPY_MIN_FILES) {
+        const char **names = malloc(count * sizeof(char *));
+        int dir_fd = open(destination, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (names != NULL && dir_fd != -1) {
+            // A source ending in '/' is no regular file and never copied here, its name may share a buffer
+            char base_buffer[NAME_MAX + 1];
+            for (int k = 0; k < count; k++) {
+                names[k] = path_base(sources[k], base_buffer, sizeof(base_buffer));
+            }
+            uring_copy_batch(sources, count, dir_fd, names, done);
+        }
+        if (dir_fd != -1) {
+            close(dir_fd);
+        }
+        free(names);
+    }
+
+    for (int k = 0; k < count; k++) {
+        const char *source = sources[k];
+        char target[PATH_MAX];
+        char base_buffer[NAME_MAX + 1];
+
+        if (done[k]) {
+            continue;
+        }
+        if (into_dir) {
+            snprintf(target, sizeof(target), "%s/%s", destination,
+                     path_base(sources[k], base_buffer, sizeof(base_buffer)));
+        } else {
+            snprintf(target, sizeof(target), "%s", destination);
+        }
+        TRACE(TRACE_INFO, "Copying file %s to %s (append mode: %d)", source, target, opts.append);
+        CopyResult result;
+        if (copy_file(source, target, &opts, &batch, &result) == -1) {
+            status = 1;
+            continue;
+        }
+        // -V: which strategy the engine ended up with, as cp -v names each copy
+        if (verbose) {
+            printf("'%s' -> '%s' (%s, %lld bytes)\n", source, target, copy_strategy_name(result.strategy),
+                   (long long)result.bytes);
+        }
+        // A sparse copy always reports its sizes, so the kept holes are visible
+        if (result.sparse) {
+            printf("'%s': sparse, apparent size %lld, allocated %lld\n", target, (long long)result.apparent,
+                   (long long)result.allocated);
+        }
+        // Same layout as cksum-style tools: checksum, two spaces, path
+        if (manifest != NULL) {
+            fprintf(manifest, "%08x  %s\n", result.checksum, target);
+        }
+        TRACE(TRACE_INFO, "File %s copied successfully to %s", source, target);
+    }
+    free(done);
+    // -S: everything copied so far becomes durable and visible together
+    if (atomic_batch_commit(&batch) == -1) {
+        status = 1;
+    }
+    if (manifest != NULL && fclose(manifest) == EOF) {
+        perror(manifest_path);
+        status = 1;
+    }
+    TRACE(TRACE_INFO, "Copy operation completed.");
+    return status;
+}
+
+static int builtin_mymv(int argc, char **argv) {
+    int force = 0;
+    int status = 0;
+    int destination_index = argc - 1;
+    int k = 1;
+
+    if (argc > 1 && strcmp(argv[1], "-f") == 0) {
+        force = 1;
+        k = 2;
+    }
+    if (destination_index <= k) {
+        fprintf(stderr, "error: mv [-f] <source> <destination>\n");
+        return 1;
+    }
+
+    for (int j = k; j < destination_index; j++) {
+        const char *source = argv[j];
+        const char *destination_dir = argv[destination_index];
+
+        TRACE(TRACE_INFO, "Moving file %s to %s", source, destination_dir);
+        if (move_file(source, destination_dir, force) == -1) {
+            status = 1;
+            continue;
+        }
+        TRACE(TRACE_INFO, "File %s moved successfully to %s", source, destination_dir);
+    }
+
+    TRACE(TRACE_INFO, "Move operation completed.");
+    return status;
+}
+
+static int builtin_myexit(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    printf("good bye \n");
+    exit(EXIT_SUCCESS);
+}
+
+static int builtin_myrm(int argc, char **argv) {
+    RemoveTreeStats stats;
+    int recursive = 0;
+    int force = 0;
+    int status = 0;
+    int k = 1;
+
+    // Check for the -r and -f options, alone or together as -rf
+    for (; k < argc && argv[k][0] == '-' && argv[k][1] != '\0'; k++) {
+        for (const char *opt = argv[k] + 1; *opt != '\0'; opt++) {
+            if (*opt == 'r' || *opt == 'R') {
+                recursive = 1;
+            } else if (*opt == 'f') {
+                force = 1;
+            } else {
+                fprintf(stderr, "myrm: unknown option -%c\n", *opt);
+                return 1;
+            }
+        }
+    }
+    if (k >= argc && !force) {
+        fprintf(stderr, "error: rm [-r] [-f] <file>...\n");
+        return 1;
+    }
+
+    struct stat root_st;
+    if (stat("/", &root_st) == -1) {
+        perror("myrm: /");
+        return 1;
+    }
+    memset(&stats, 0, sizeof(stats));
+    for (; k < argc; k++) {
+        const char *file_path = argv[k];
+
+        // Trailing slashes are ignored, so ./ and a/..// end in . or .. too
+        char base_buffer[NAME_MAX + 1];
+        const char *base = path_base(file_path, base_buffer, sizeof(base_buffer));
+        int is_dot = strcmp(base, ".") == 0 || strcmp(base, "..") == 0;
+
+        // Like rm --preserve-root, never remove the root (however it is spelled: //, /./, ...)
+        // or a path ending in . or ..
+        struct stat st;
+        int is_root = lstat(file_path, &st) == 0 && st.st_dev == root_st.st_dev && st.st_ino == root_st.st_ino;
+        if (is_root || strcmp(file_path, "/") == 0 || is_dot) {
+            fprintf(stderr, "myrm: refusing to remove '%s'\n", file_path);
+            status = 1;
+            continue;
+        }
+        TRACE(TRACE_INFO, "Removing file %s", file_path);
+        if (recursive ? remove_tree(file_path, force, &stats) == -1 : remove_file(file_path, force) == -1) {
+            status = 1;
+            if (stats.failed != 0) {
+                fprintf(stderr, "myrm: %s: removal stopped: %s\n", file_path, strerror(stats.failed));
+                break;
+            }
+            continue;
+        }
+        TRACE(TRACE_INFO, "File %s removed successfully", file_path);
+    }
+    return status;
+}
+
+static int builtin_myhelp(int argc, char **argv) {
+    size_t count;
+    const Builtin *table = builtin_table(&count);
+
+    if (argc < 2) {
+        // No command given: list every builtin
+        for (size_t k = 0; k < count; k++) {
+            printf("%-10s %s\n", table[k].name, table[k].help);
+        }
+        return 0;
+    }
+
+    const Builtin *builtin = builtin_lookup(argv[1]);
+    if (builtin == NULL) {
+        printf("%s: not a builtin command\n", argv[1]);
+        return 1;
+    }
+    printf("%s: %s\n", builtin->name, builtin->help);
+    return 0;
+}
+
+static int builtin_envir(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    env_command();
+    return 0;
+}
+
+static int builtin_mycd(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "error: cd <path>\n");
+        return 1;
+    }
+    cd_command(argv[1]);
+    return 0;
+}
+
+static int builtin_mytype(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "error: type <command>\n");
+        return 1;
+    }
+    if (is_internal(argv[1])) {
+        printf("internal command!!\n");
+    } else if (is_external(argv[1])) {
+        printf("external command!!\n");
+    } else {
+        printf("unsupported command!!\n");
+    }
+    return 0;
+}
+
+static int builtin_myuptime(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    get_uptime_with_time();
+    return 0;
+}
+
+static int builtin_myfree(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    free_command();
+    return 0;
+}
+
+static int builtin_myls(int argc, char **argv) {
+    ls_command_implementation(argc, argv);
+    return 0;
+}
+
+static int builtin_myhash(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "-r") == 0) {
+        path_cache_reset();
+        return 0;
+    }
+    if (argc > 1) {
+        fprintf(stderr, "error: hash [-r]\n");
+        return 1;
+    }
+    path_cache_print();
+    return 0;
+}
+
+static int builtin_myidcache(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "-r") == 0) {
+        id_cache_reset();
+        return 0;
+    }
+    if (argc == 3 && strcmp(argv[1], "-t") == 0) {
+        char *end;
+        long seconds = strtol(argv[2], &end, 10);
+        if (*argv[2] == '\0' || *end != '\0' || seconds < 0) {
+            fprintf(stderr, "myidcache: invalid ttl: %s\n", argv[2]);
+            return 1;
+        }
+        id_cache_set_ttl(seconds);
+        return 0;
+    }
+    if (argc > 1) {
+        fprintf(stderr, "error: myidcache [-r | -t seconds]\n");
+        return 1;
+    }
+    id_cache_print();
+    return 0;
+}
+
+static int builtin_mypipesize(int argc, char **argv) {
+    if (argc < 2) {
+        int size = pipeline_get_pipe_size();
+        if (size == 0) {
+            printf("pipe size: kernel default\n");
+        } else {
+            printf("pipe size: %d bytes\n", size);
+        }
+        return 0;
+    }
+
+    char *end;
+    long size = strtol(argv[1], &end, 10);
+    if (*end != '\0' || size < 0 || size > INT_MAX) {
+        fprintf(stderr, "error: pipesize [bytes]\n");
+        return 1;
+    }
+    pipeline_set_pipe_size((int)size);
+    return 0;
+}
+
+static int builtin_mytrace(int argc, char **argv) {
+    if (argc < 2) {
+        printf("trace level: %s, events recorded: %lu\n", trace_level_name(trace_level), trace_event_count());
+        return 0;
+    }
+    if (strcmp(argv[1], "dump") == 0) {
+        int fd = STDOUT;
+        if (argc > 2) {
+            fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd == -1) {
+                perror("opening trace file failed");
+                return 1;
+            }
+        }
+        fflush(stdout);
+        int written = trace_dump(fd);
+        if (fd != STDOUT) {
+            close(fd);
+        }
+        if (written == -1) {
+            perror("writing trace failed");
+            return 1;
+        }
+        return 0;
+    }
+    if (strcmp(argv[1], "clear") == 0) {
+        trace_clear();
+        return 0;
+    }
+
+    int level = trace_level_from_name(argv[1]);
+    if (level == -1) {
+        fprintf(stderr, "error: trace [off|error|info|debug] | dump [file] | clear\n");
+        return 1;
+    }
+    trace_level = level;
+    return 0;
+}
+
+static int builtin_myparallel(int argc, char **argv) {
+    return parallel_command(argc, argv);
+}
+
+static int builtin_jobs(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    jobs_print();
+    return 0;
+}
+
+static int builtin_fg(int argc, char **argv) {
+    Job *job = job_find(argc > 1 ? argv[1] : NULL);
+    if (job == NULL) {
+        fprintf(stderr, "fg: %s: no such job\n", argc > 1 ? argv[1] : "current");
+        return 1;
+    }
+    return job_foreground(job);
+}
+
+static int builtin_bg(int argc, char **argv) {
+    Job *job = job_find(argc > 1 ? argv[1] : NULL);
+    if (job == NULL) {
+        fprintf(stderr, "bg: %s: no such job\n", argc > 1 ? argv[1] : "current");
+        return 1;
+    }
+    return job_background(job);
+}
+
+static int builtin_wait(int argc, char **argv) {
+    if (argc < 2) {
+        return jobs_wait_all();
+    }
+
+    int status = 0;
+    for (int k = 1; k < argc; k++) {
+        Job *job = job_find(argv[k]);
+        if (job == NULL) {
+            fprintf(stderr, "wait: %s: no such job\n", argv[k]);
+            status = PIPELINE_STATUS_NOT_FOUND;
+            continue;
+        }
+        job->background = 1;  // wait never hands the terminal over
+        status = job_wait(job, NULL);
+    }
+    return status;
+}
+
+/*-----------------registry---------------*/
+
+// Every builtin is described exactly once here, dispatch, mytype and myhelp all read this table
+static const Builtin builtins[] = {
+    {.name = "mypwd", .handler = builtin_mypwd, .help = "used to print what directory you are at"},
+    {.name = "myecho", .handler = builtin_myecho, .help = "used to print what you give it on terminal"},
+    {.name = "mycp", .handler = builtin_mycp, .help = "used to copy what you give it as source to destination given, -r copies whole directories, -j n copies a big file on n threads, -v verifies each copy by checksum, -V shows the copy strategy, -U copies many small files through io_uring, -m file records the checksums, -u skips files with the same size and mtime and -d rewrites only changed blocks, -s syncs each file and -S the whole batch at once, -g shows progress and -D uses O_DIRECT"},
+    {.name = "mymv", .handler = builtin_mymv, .help = "used to move what you give it as source to destination given"},
+    {.name = "myexit", .handler = builtin_myexit, .help = "used to exit from the shell"},
+    {.name = "myrm", .handler = builtin_myrm, .help = "used to remove the files given, -r removes whole directories and -f ignores missing files"},
+    {.name = "myhelp", .handler = builtin_myhelp, .help = "used to show help for a command, or list all builtins"},
+    {.name = "envir", .handler = builtin_envir, .help = "used to display environment variables"},
+    {.name = "mycd", .handler = builtin_mycd, .help = "used to go to whatever directory you want"},
+    {.name = "mytype", .handler = builtin_mytype, .help = "used to give us the type of command you insert"},
+    {.name = "myuptime", .handler = builtin_myuptime, .help = "used to get time"},
+    {.name = "myfree", .handler = builtin_myfree, .help = "used to get memory information"},
+    {.name = "myls", .handler = builtin_myls, .help = "used to list directory contents [-aldtiuc1f]"},
+    {.name = "myhash", .handler = builtin_myhash, .help = "used to show the remembered command paths and hits, -r forgets them"},
+    {.name = "myidcache", .handler = builtin_myidcache, .help = "used to show the cached owner/group names with hit and miss counts, -r forgets them, -t seconds sets how long a name is trusted (0 = until /etc/passwd or /etc/group changes)"},
+    {.name = "mytrace", .handler = builtin_mytrace, .help = "used to set the trace level (off/error/info/debug), dump [file] or clear the trace buffer"},
+    {.name = "jobs", .handler = builtin_jobs, .help = "used to list background and stopped jobs"},
+    {.name = "fg", .handler = builtin_fg, .help = "used to bring a job (%n, default the current one) to the foreground"},
+    {.name = "bg", .handler = builtin_bg, .help = "used to continue a stopped job (%n) in the background"},
+    {.name = "wait", .handler = builtin_wait, .help = "used to wait for all background jobs, or the given %n / pid"},
+    {.name = "mypipesize", .handler = builtin_mypipesize, .help = "used to show or set the capacity of pipes between pipeline stages (0 = default)"},
+    {.name = "mytime", .handler = NULL, .help = "used to show wall time, CPU time, memory, faults and context switches of a command or pipeline: [-r runs]", .segment_handler = time_segment},
+    {.name = "myparallel", .handler = builtin_myparallel, .help = "used to run a command over the lines of stdin (or -a file) on all CPUs: [-j n] [-n args] [-k] [-t]"},
+};
+#define BUILTIN_COUNT (sizeof(builtins) / sizeof(builtins[0]))
+
+static unsigned char hash_slots[BUILTIN_HASH_SIZE];  // Index + 1 into builtins[], 0 for empty
+static unsigned int hash_seed;
+static int hash_ready = 0;
+
+/* FNV-1a mixed with a seed, the seed is picked so the table has no collisions.
+ * The final shifts fold the high bits down: FNV's low bits alone only depend on the
+ * low bits of the seed, which leaves too few distinct seeds to try.
+ */
+static unsigned int builtin_hash(const char *name, unsigned int seed) {
+    unsigned int h = 2166136261u ^ seed;
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    return h & (BUILTIN_HASH_SIZE - 1);
+}
+
+/* Search for a seed that maps every builtin to its own slot (done once, on first lookup) */
+static void build_perfect_hash(void) {
+    for (unsigned int seed = 0; ; seed++) {
+        int collision = 0;
+        memset(hash_slots, 0, sizeof(hash_slots));
+        for (size_t k = 0; k < BUILTIN_COUNT; k++) {
+            unsigned int slot = builtin_hash(builtins[k].name, seed);
+            if (hash_slots[slot] != 0) {
+                collision = 1;
+                break;
+            }
+            hash_slots[slot] = (unsigned char)(k + 1);
+        }
+        if (!collision) {
+            hash_seed = seed;
+            hash_ready = 1;
+            return;
+        }
+    }
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Return the builtin called 'name', or NULL. One hash and one strcmp, whatever the table size. */
+const Builtin *builtin_lookup(const char *name) {
+    if (!hash_ready) {
+        build_perfect_hash();
+    }
+    unsigned char index = hash_slots[builtin_hash(name, hash_seed)];
+    if (index == 0 || strcmp(builtins[index - 1].name, name) != 0) {
+        return NULL;
+    }
+    return &builtins[index - 1];
+}
+
+const Builtin *builtin_table(size_t *count) {
+    *count = BUILTIN_COUNT;
+    return builtins;
+}
@@ -0,0 +1,27 @@
+/*
+Author: Assem Samy
+File: builtins.h
+Comment: Registry of the shell builtins, shared by command dispatch, mytype and myhelp
+*/
+
+#ifndef BUILTINS_H
+#define BUILTINS_H
+/*-----------------includes section--------------*/
+#include <stddef.h>
+#include "tokenizer.h"
+/*----------------macros declarations-----------------*/
+#define BUILTIN_HASH_SIZE   64    // Power of two, comfortably above the number of builtins
+/*-----------------types declarations-----------------*/
+typedef int (*builtin_handler)(int argc, char **argv);
+typedef int (*builtin_segment_handler)(TokenList *tl, size_t from, size_t to);
+
+typedef struct {
+    const char *name;
+    builtin_handler handler;    // NULL when segment_handler is set
+    const char *help;    // One line printed by myhelp
+    builtin_segment_handler segment_handler;  // Prefix builtins (mytime): get the whole command, operators included
+} Builtin;
+/*-----------section contains functions declarations------------*/
+const Builtin *builtin_lookup(const char *name);
+const Builtin *builtin_table(size_t *count);
+#endif
@@ -0,0 +1,110 @@
+/*
+Author: Assem Samy
+File: checksum.c
+Comment: CRC32C with runtime CPU dispatch, the crc32 instruction (SSE4.2) or slicing-by-8 tables
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "checksum.h"
+#include <pthread.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+/*-----------------variables and static functions---------------*/
+typedef uint32_t (*crc32c_fn)(uint32_t crc, const unsigned char *p, size_t len);
+
+static uint32_t crc_table[8][256];        // crc_table[k][b]: b followed by k zero bytes
+static crc32c_fn crc_impl;
+static const char *crc_impl_name;
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+/* Eight bytes per step through eight tables, about 1 byte per cycle on any CPU */
+static uint32_t crc32c_table(uint32_t crc, const unsigned char *p, size_t len) {
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        word ^= crc;   // Little endian: the low four bytes take the running CRC
+        crc = crc_table[7][word & 0xFF] ^ crc_table[6][(word >> 8) & 0xFF] ^
+              crc_table[5][(word >> 16) & 0xFF] ^ crc_table[4][(word >> 24) & 0xFF] ^
+              crc_table[3][(word >> 32) & 0xFF] ^ crc_table[2][(word >> 40) & 0xFF] ^
+              crc_table[1][(word >> 48) & 0xFF] ^ crc_table[0][word >> 56];
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) {
+        crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+/* The crc32 instruction computes this exact polynomial, 8 bytes per instruction */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *p, size_t len) {
+    uint64_t crc64 = crc;
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        crc64 = _mm_crc32_u8((uint32_t)crc64, *p++);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) {
+        crc64 = _mm_crc32_u8((uint32_t)crc64, *p++);
+    }
+    return (uint32_t)crc64;
+}
+#endif
+
+/* Build the tables once and pick the fastest implementation this CPU runs */
+static void crc32c_init(void) {
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+        }
+        crc_table[0][b] = crc;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (int b = 0; b < 256; b++) {
+            uint32_t prev = crc_table[k - 1][b];
+            crc_table[k][b] = crc_table[0][prev & 0xFF] ^ (prev >> 8);
+        }
+    }
+
+    crc_impl = crc32c_table;
+    crc_impl_name = "table";
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc_impl = crc32c_sse42;
+        crc_impl_name = "sse4.2";
+    }
+#endif
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Continue a CRC32C over 'len' more bytes. Start with CRC32C_INIT and feed the
+ * data in any number of pieces, the result is the standard CRC32C of all of it.
+ */
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t len) {
+    pthread_once(&crc_once, crc32c_init);
+    return ~crc_impl(~crc, data, len);
+}
+
+/* "sse4.2" or "table", for traces and benchmarks */
+const char *crc32c_impl_name(void) {
+    pthread_once(&crc_once, crc32c_init);
+    return crc_impl_name;
+}
@@ -0,0 +1,18 @@
+/*
+Author: Assem Samy
+File: checksum.h
+Comment: CRC32C (Castagnoli) used by mycp -v, SSE4.2 crc32 instruction when the CPU has it, table driven otherwise
+*/
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+/*-----------------includes section--------------*/
+#include <stddef.h>
+#include <stdint.h>
+/*----------------macros declarations-----------------*/
+#define CRC32C_POLY 0x82F63B78u   // Reflected Castagnoli polynomial, the one SSE4.2, iSCSI and ext4 use
+#define CRC32C_INIT 0u            // Start value for crc32c_update(), the inversions are done inside
+/*-----------section contains functions declarations------------*/
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t len);
+const char *crc32c_impl_name(void);
+#endif
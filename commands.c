@@ -6,37 +6,22 @@ Comment: Contains all function definitions used in shell.c
 
 /*-----------------Includes Section--------------*/
 #include "commands.h"
+#include "builtins.h"
+#include "pathcache.h"
+#include "launch.h"
+#include "pipeline.h"
+#include "trace.h"
+#include "copy.h"
+#include "atomicfile.h"
+#include "entrystore.h"
+#include "idcache.h"
+#include "outbuf.h"
 /*-----------------variables and static functions concerning ls---------------*/
-typedef struct {
-    char name[TOKEN_LENGTH];
-    time_t time; // Generic time field
-    int type;    // Type of time (0 for change time, 1 for modification time, 2 for access time)
-    int sort_type;// 0 for time, 1 for name
-} FileEntry;
-
-// Comparison functions for different types of times
-static int compare_time(const void *a, const void *b) {
-    const FileEntry *entryA = (const FileEntry *)a;
-    const FileEntry *entryB = (const FileEntry *)b;
-
-    // Compare times (descending order)
-    if (entryA->time < entryB->time) return 1;
-    if (entryA->time > entryB->time) return -1;
-    return 0;
-}
-
 static void usageError(const char *progName, const char *msg, int opt) {
     fprintf(stderr, "%s: %s -%c\n", progName, msg, opt);
     exit(EXIT_FAILURE);
 }
 
-static int compare_name(const void *p1, const void *p2) {
-    const FileEntry *entryA = (const FileEntry *)p1;
-    const FileEntry *entryB = (const FileEntry *)p2;
-
-    return strcmp(entryA->name, entryB->name);
-}
-
 static int is_directory(const char *path) {
     struct stat path_stat;
     if (stat(path, &path_stat) != 0) {
@@ -46,167 +31,134 @@ static int is_directory(const char *path) {
     return S_ISDIR(path_stat.st_mode);
 }
 
-static void do_ls_directory(char *dir, int hidden_files, int sorting_required, int line_by_line) {
-    struct dirent *entry;
-    FileEntry entries[MAX_ENTRIES];
-    DIR *dp = opendir(dir);
-
-    if (dp == NULL) {
-        fprintf(stderr, "Cannot open directory: %s\n", dir);
-        return;
+/* One row of a long listing, the columns of printf("%-8lu %-*s   %-*ld %-*s %-*s %-*ld %-*s %-*s\n") */
+static void out_long_row(OutBuffer *out, int inode_print, unsigned long ino, const char *perms, long nlink,
+                         const char *user, const char *group, long size, time_t time, const char *name) {
+    if (inode_print) {
+        out_ulong(out, ino, 8);
+        out_char(out, ' ');
     }
+    out_str(out, perms, 10);
+    out_spaces(out, 3);
+    out_long(out, nlink, 4);
+    out_char(out, ' ');
+    out_str(out, user, 5);
+    out_char(out, ' ');
+    out_str(out, group, 5);
+    out_char(out, ' ');
+    out_long(out, size, 8);
+    out_char(out, ' ');
+    out_time(out, time, 20);
+    out_char(out, ' ');
+    out_str(out, name, 30);
+    out_char(out, '\n');
+}
 
-    errno = 0;
-    int count = 0;
-    while ((entry = readdir(dp)) != NULL) {
-        if (count >= MAX_ENTRIES) {
-            fprintf(stderr, "Too many entries\n");
-            break;
-        }
-
-
-        if (!hidden_files && (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)) {
-            continue;
-        }
-
-        strncpy(entries[count].name, entry->d_name, TOKEN_LENGTH - 1);
-        entries[count].name[TOKEN_LENGTH - 1] = '\0'; // Ensure null-termination
+static void do_ls_directory(char *dir, int hidden_files, int sorting_required, int line_by_line) {
+    EntryStore store;
 
-        count++;
+    entry_store_init(&store);
+    if (entry_store_load(&store, dir, hidden_files ? ENTRY_LOAD_DOTS : 0) == -1) {
+        fprintf(stderr, "Cannot open directory: %s: %s\n", dir, strerror(errno));
+        entry_store_free(&store);
+        return;
     }
 
-    closedir(dp);
-
     if (sorting_required) {
         // Sort entries by name
-        qsort(entries, count, sizeof(FileEntry), compare_name);
+        entry_store_sort_by_name(&store);
     }
 
+    int count = (int)store.count;
+    OutBuffer out;
+    out_init(&out, STDOUT_FILENO);
     if (line_by_line) {
         // Print entries line by line
         for (int i = 0; i < count; i++) {
-            printf("%s\n", entries[i].name);
+            const DirEntry *entry = &store.entries[i];
+            out_bytes(&out, entry_name(&store, entry), entry->name_len);
+            out_char(&out, '\n');
         }
     } else {
         // Determine maximum width for column alignment
-        int name_width = 0;
-        for (int i = 0; i < count; i++) {
-            int len = strlen(entries[i].name);
-            if (len > name_width) {
-                name_width = len;
-            }
-        }
+        int name_width = entry_store_max_name_len(&store);
         name_width += 4; // Add extra space for readability
 
         // Calculate number of columns based on terminal width
         int terminal_width = 80; // Adjust terminal width as needed
-        int cols = terminal_width / name_width;  
+        int cols = terminal_width / name_width;
+        if (cols < 1) {
+            cols = 1;  // A name wider than the terminal gets a line of its own
+        }
 
         // Print entries in columns
         for (int i = 0; i < count; i++) {
-            printf("%-*s", name_width, entries[i].name);
+            out_str(&out, entry_name(&store, &store.entries[i]), name_width);
             if ((i + 1) % cols == 0 || i == count - 1) {
-                printf("\n");
+                out_char(&out, '\n');
             }
         }
     }
+    out_close(&out);
+    entry_store_free(&store);
 }
 
-static void show_stat_info_each(char token[][TOKEN_LENGTH], const char *dir, char t_check, int sort_by_name, int hidden_files, int inode_print) {
-    struct dirent *entry;
-    int capacity = INITIAL_CAPACITY;  // Track current capacity
-    FileEntry *entries = malloc(capacity * sizeof(FileEntry));
-    if (entries == NULL) {
-        perror("malloc failed");
-        return;
-    }
+static void show_stat_info_each(char **token, const char *dir, char t_check, int sort_by_name, int hidden_files, int inode_print) {
+    EntryStore store;
 
-    DIR *dp = opendir(dir);
-    if (dp == NULL) {
-        fprintf(stderr, "Cannot open directory: %s\n", dir);
-        free(entries);
+    entry_store_init(&store);
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd == -1 || entry_store_scan(&store, dir_fd, hidden_files ? ENTRY_LOAD_DOTS : 0) == -1) {
+        fprintf(stderr, "Cannot open directory: %s: %s\n", dir, strerror(errno));
+        if (dir_fd != -1) {
+            close(dir_fd);
+        }
+        entry_store_free(&store);
         return;
     }
 
-    errno = 0;
-    int count = 0;
-    while ((entry = readdir(dp)) != NULL) {
-        if (count >= capacity) {
-            // Resize the array if necessary
-            capacity *= 2;
-            FileEntry *new_entries = realloc(entries, capacity * sizeof(FileEntry));
-            if (new_entries == NULL) {
-                perror("realloc failed");
-                free(entries);
-                closedir(dp);
-                return;
-            }
-            entries = new_entries;
-        }
-
-        // Skip special entries like '.' and '..' unless hidden_files is true
-        if (!hidden_files && (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)) {
-            continue;
-        }
-
-        strncpy(entries[count].name, entry->d_name, TOKEN_LENGTH - 1);
-        entries[count].name[TOKEN_LENGTH - 1] = '\0';  // Ensure null-termination
-
-        char path[PATH_MAX];
-        snprintf(path, sizeof(path), "%s/%s", dir, entries[count].name);
-        struct stat info;
-        if (lstat(path, &info) == -1) {
-            perror("lstat failed");
-            continue;
-        }
-
-        // Only set time if t_check is valid ('c', 'm', or 'a')
-        if (t_check == 'c') {
-            entries[count].time = info.st_ctime;
-        } else if (t_check == 'm') {
-            entries[count].time = info.st_mtime;
-        } else if (t_check == 'a') {
-            entries[count].time = info.st_atime;
-        } else {
-            // Skip setting the time if t_check is not valid
-            entries[count].time = 0; // Optional: Set to 0 or leave uninitialized depending on your design
-        }
-
-        count++;
+    // One statx per entry for just the columns shown, plus the time picked by t_check ('c', 'm', or 'a')
+    unsigned int mask = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID | STATX_SIZE;
+    if (inode_print) {
+        mask |= STATX_INO;
     }
-    closedir(dp);
+    if (entry_store_stat(&store, dir_fd, mask, t_check) == -1) {
+        fprintf(stderr, "Cannot list directory: %s: %s\n", dir, strerror(errno));
+        close(dir_fd);
+        entry_store_free(&store);
+        return;
+    }
+    close(dir_fd);
+    int count = (int)store.count;
 
     // Sort entries based on the chosen criterion
     if (sort_by_name) {
-        qsort(entries, count, sizeof(FileEntry), compare_name);
+        entry_store_sort_by_name(&store);
     } else if (t_check == 'c' || t_check == 'm' || t_check == 'a') {
-        qsort(entries, count, sizeof(FileEntry), compare_time);
+        entry_store_sort_by_time(&store);
     } else {
         // No sorting happens if t_check is invalid and sort_by_name is not selected
-        // You can add a log here to inform the user if needed.
     }
 
+    OutBuffer out;
+    out_init(&out, STDOUT_FILENO);
     for (int j = 0; j < count; j++) {
-        char path[PATH_MAX];
-        char timebuf[20] = {0};  // Initialize time buffer to avoid undefined behavior
-
-        snprintf(path, sizeof(path), "%s/%s", dir, entries[j].name);
-        struct stat info;
-        if (lstat(path, &info) == -1) {
-            perror("lstat failed");
-            continue;
-        }
-
-        int mode = info.st_mode;
+        const DirEntry *entry = &store.entries[j];
+        const EntryMeta *info = entry_meta(&store, entry);
+        int mode = info->mode;
         char str[11] = "----------";
-        struct group *grp = getgrgid(info.st_gid);
-        struct passwd *pwd = getpwuid(info.st_uid);
+        const char *grp = id_cache_group(info->gid);
+        const char *pwd = id_cache_user(info->uid);
 
         if (grp == NULL) {
-            printf("Unknown group ID: %d\n", info.st_gid);
+            out_str(&out, "Unknown group ID: ", 0);
+            out_ulong(&out, info->gid, 0);
+            out_char(&out, '\n');
         }
         if (pwd == NULL) {
-            printf("Unknown user ID: %d\n", info.st_uid);
+            out_str(&out, "Unknown user ID: ", 0);
+            out_ulong(&out, info->uid, 0);
+            out_char(&out, '\n');
         }
 
         if (S_ISDIR(mode)) str[0] = 'd';
@@ -224,41 +176,19 @@ static void show_stat_info_each(char token[][TOKEN_LENGTH], const char *dir, cha
         if (mode & S_IWOTH) str[8] = 'w';
         if (mode & S_IXOTH) str[9] = 'x';
 
-        struct tm *tm_info = localtime(&entries[j].time);
-        if (strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M", tm_info) == 0) {
-            perror("strftime failed");
-            timebuf[0] = '\0';  // Set empty string if formatting fails
-        }
-
-        if (!inode_print) {
-            printf("%-*s   %-*ld %-*s %-*s %-*ld %-*s %-*s\n",
-                   10, str,
-                   4, info.st_nlink,
-                   5, pwd ? pwd->pw_name : "UNKNOWN",
-                   5, grp ? grp->gr_name : "UNKNOWN",
-                   8, info.st_size,
-                   20, timebuf,
-                   30, entries[j].name);
-        } else {
-            printf("%-8lu %-*s   %-*ld %-*s %-*s %-*ld %-*s %-*s\n",
-                   (unsigned long)info.st_ino,
-                   10, str,
-                   4, info.st_nlink,
-                   5, pwd ? pwd->pw_name : "UNKNOWN",
-                   5, grp ? grp->gr_name : "UNKNOWN",
-                   8, info.st_size,
-                   20, timebuf,
-                   30, entries[j].name);
-        }
+        out_long_row(&out, inode_print, (unsigned long)entry->ino, str, (long)info->nlink,
+                     pwd ? pwd : "UNKNOWN", grp ? grp : "UNKNOWN", (long)info->size, entry->time,
+                     entry_name(&store, entry));
     }
 
-    free(entries);
+    out_close(&out);
+    entry_store_free(&store);
 }
 
 
 
 
-static void show_directory(char token[][TOKEN_LENGTH], char *dir, int l_check, int inode_print) {
+static void show_directory(char **token, char *dir, int l_check, int inode_print) {
     
     struct dirent *entry;
     DIR *dp = opendir(dir);
@@ -267,22 +197,12 @@ static void show_directory(char token[][TOKEN_LENGTH], char *dir, int l_check, i
         return;
     }
 
-    // Column widths
-    const int PERMS_WIDTH = 10;
-    const int LINKS_WIDTH = 4;
-    const int UID_WIDTH = 5;
-    const int GID_WIDTH = 5;
-    const int SIZE_WIDTH = 8;
-    const int TIME_WIDTH = 20;
+    // Name column width without -l, out_long_row() has the long format's widths
     const int NAME_WIDTH = 30;
 
 
         struct stat info;
         char path[PATH_MAX];
-        char timebuf[20];
-
-        // Initialize timebuf to ensure it's all zeroes
-        memset(timebuf, '\0', sizeof(timebuf));
 
         // Print the directory itself
         snprintf(path, sizeof(path), "%s", dir);
@@ -294,8 +214,8 @@ static void show_directory(char token[][TOKEN_LENGTH], char *dir, int l_check, i
 
         int mode = info.st_mode;
         char str[11] = "----------";
-        struct group *grp = getgrgid(info.st_gid);
-        struct passwd *pwd = getpwuid(info.st_uid);
+        const char *grp = id_cache_group(info.st_gid);
+        const char *pwd = id_cache_user(info.st_uid);
 
         // File type
         if (S_ISDIR(mode)) str[0] = 'd';
@@ -321,197 +241,140 @@ static void show_directory(char token[][TOKEN_LENGTH], char *dir, int l_check, i
         if (mode & S_ISGID) str[5] = (str[5] == 'x') ? 's' : 'S';
         if (mode & S_ISVTX) str[8] = (str[8] == 'x') ? 't' : 'T';
 
-        // Format the time based on the type
-        struct tm *tm_info = localtime(&info.st_mtime);
-        if (strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M", tm_info) == 0) {
-            perror("strftime failed");
-            timebuf[0] = '\0'; // In case of failure, provide an empty string
-        }
+        OutBuffer out;
+        out_init(&out, STDOUT_FILENO);
 	if (!l_check) {
-		if (!inode_print) {
-        		printf("%s\n", dir);
+		if (inode_print) {
+        		out_ulong(&out, (unsigned long)info.st_ino, 8);
+        		out_char(&out, ' ');
+        		out_str(&out, dir, NAME_WIDTH);
         	}else{
-        		printf("%-8lu %-*s\n", (unsigned long)info.st_ino, NAME_WIDTH, dir);
+        		out_str(&out, dir, 0);
         	}
+        	out_char(&out, '\n');
         }else{
-		if (!inode_print) {
-		    // Print file info
-		    printf("%-*s   %-*ld %-*s %-*s %-*ld %-*s %-*s\n",
-		           PERMS_WIDTH, str,
-		           LINKS_WIDTH, info.st_nlink,
-		           UID_WIDTH, pwd ? pwd->pw_name : "UNKNOWN",
-		           GID_WIDTH, grp ? grp->gr_name : "UNKNOWN",
-		           SIZE_WIDTH, info.st_size,
-		           TIME_WIDTH, timebuf,
-		           NAME_WIDTH, dir);
-		} else {
-		    printf("%-8lu %-*s   %-*ld %-*s %-*s %-*ld %-*s ",
-		           (unsigned long)info.st_ino,
-		           PERMS_WIDTH, str,
-		           LINKS_WIDTH, info.st_nlink,
-		           UID_WIDTH, pwd ? pwd->pw_name : "UNKNOWN",
-		           GID_WIDTH, grp ? grp->gr_name : "UNKNOWN",
-		           SIZE_WIDTH, info.st_size,
-		           TIME_WIDTH, timebuf
-		           );
-		    printf("%-*s\n", NAME_WIDTH, dir);
-		}
+		// Print file info, the time is the modification time
+		out_long_row(&out, inode_print, (unsigned long)info.st_ino, str, (long)info.st_nlink,
+		             pwd ? pwd : "UNKNOWN", grp ? grp : "UNKNOWN", (long)info.st_size, info.st_mtime, dir);
 	}
+	out_close(&out);
     
     closedir(dp);
 }
-static void show_inode_number(char token[][TOKEN_LENGTH], char *dir, int inode_long_format_check, int line_by_line,int sorting_required) {
-    struct dirent *entry;
-    FileEntry entries[1000];
-
-    DIR *dp = opendir(dir);
-    if (dp == NULL) {
-        fprintf(stderr, "Cannot open directory: %s\n", dir);
+static void show_inode_number(char **token, char *dir, int inode_long_format_check, int line_by_line,int sorting_required) {
+    EntryStore store;
+
+    entry_store_init(&store);
+    // Skip special entries like '.' and '..'. The inode numbers come with the names (d_ino), no lstat
+    if (entry_store_load(&store, dir, 0) == -1) {
+        fprintf(stderr, "Cannot open directory: %s: %s\n", dir, strerror(errno));
+        entry_store_free(&store);
         return;
     }
-
-    errno = 0;
-    int count = 0;
-    char mode_time=0;
-    while ((entry = readdir(dp)) != NULL) {
-        if (count >= sizeof(entries) / sizeof(entries[0])) {
-            fprintf(stderr, "Too many entries\n");
-            break;
-        }
-        
-        // Skip special entries like '.' and '..'
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-
-        // Copy entry name
-        strncpy(entries[count].name, entry->d_name, TOKEN_LENGTH - 1);
-        entries[count].name[TOKEN_LENGTH - 1] = '\0'; // Ensure null-termination
-
-        // Build the full path for the file
-        char path[PATH_MAX];
-        snprintf(path, sizeof(path), "%s/%s", dir, entries[count].name);
-        struct stat info;
-        if (lstat(path, &info) == -1) {
-            perror("lstat failed");
-            continue; // Skip this entry if lstat fails
-        }
-        // Store inode number in the time field
-        entries[count].time = info.st_ino;
-        count++;
-    }
-    closedir(dp);
+    int count = (int)store.count;
 
     // Sort entries by name
     if(sorting_required){
-    	qsort(entries, count, sizeof(FileEntry), compare_name);
-    }else{
+    	entry_store_sort_by_name(&store);
     }
     // Determine maximum widths for formatting
-    int name_width = 0;
-    for (int j = 0; j < count; j++) {
-        if (strlen(entries[j].name) > name_width) {
-            name_width = strlen(entries[j].name);
-        }
-    }
+    int name_width = entry_store_max_name_len(&store);
     name_width += 4; // Add extra space for better readability
 
+    OutBuffer out;
+    out_init(&out, STDOUT_FILENO);
     if (line_by_line) {
         for (int j = 0; j < count; j++) {
-            printf("%-*lu %s\n", name_width, (unsigned long)entries[j].time, entries[j].name);
+            const DirEntry *entry = &store.entries[j];
+            out_ulong(&out, (unsigned long)entry->ino, name_width);
+            out_char(&out, ' ');
+            out_bytes(&out, entry_name(&store, entry), entry->name_len);
+            out_char(&out, '\n');
         }
     } else {
         // Print entries in columns
         int cols = 80 / COLUMN_WIDTH;  // Assuming terminal width is 80 columns
         for (int i = 0; i < count; i++) {
+            const DirEntry *entry = &store.entries[i];
             // Print entry with aligned columns
-            printf("%-*lu %-*s", 10, (unsigned long)entries[i].time, name_width, entries[i].name);
+            out_ulong(&out, (unsigned long)entry->ino, 10);
+            out_char(&out, ' ');
+            out_str(&out, entry_name(&store, entry), name_width);
             if ((i + 1) % cols == 0 || i == count - 1) {
-                printf("\n");
+                out_char(&out, '\n');
             }
         }
     }
+    out_close(&out);
+    entry_store_free(&store);
 }
-static void sort_files(char token[][TOKEN_LENGTH],const char *dir, int time_type,int line_by_line,int hidden_files) {
-    struct dirent *entry;
-    FileEntry entries[1000];
-    DIR *dp = opendir(dir);
-    if (dp == NULL) {
-        fprintf(stderr, "Cannot open directory: %s\n", dir);
-        return;
-    }
-
-    errno = 0;
-    int count = 0;
-    while ((entry = readdir(dp)) != NULL) {
-        if (count >= sizeof(entries) / sizeof(entries[0])) {
-            fprintf(stderr, "Too many entries\n");
+static void sort_files(char **token,const char *dir, int time_type,int line_by_line,int hidden_files) {
+    EntryStore store;
+    char time_field;
+
+    // Set the appropriate time based on time_type
+    switch (time_type) {
+        case 0: // Change time
+            time_field = 'c';
             break;
-        }
-
-        // Skip special entries like '.' and '..'
-        if (!hidden_files && (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)) {
-            continue;
-        }
-
-        strncpy(entries[count].name, entry->d_name, TOKEN_LENGTH - 1);
-        entries[count].name[TOKEN_LENGTH - 1] = '\0'; // Ensure null-termination
-
-        // Build the full path for the file and get its time
-        char path[PATH_MAX];
-        snprintf(path, sizeof(path), "%s/%s", dir, entries[count].name);
-        struct stat info;
-        if (lstat(path, &info) == -1) {
-            perror("lstat failed");
-            continue;
-        }
+        case 1: // Modification time
+            time_field = 'm';
+            break;
+        case 2: // Access time
+            time_field = 'a';
+            break;
+        default:
+            fprintf(stderr, "Invalid time type\n");
+            return;
+    }
 
-        // Set the appropriate time based on time_type
-        switch (time_type) {
-            case 0: // Change time
-                entries[count].time = info.st_ctime;
-                break;
-            case 1: // Modification time
-                entries[count].time = info.st_mtime;
-                break;
-            case 2: // Access time
-                entries[count].time = info.st_atime;
-                break;
-            default:
-                fprintf(stderr, "Invalid time type\n");
-                closedir(dp);
-                return;
+    entry_store_init(&store);
+    // '.' and '..' only with -a
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd == -1 || entry_store_scan(&store, dir_fd, hidden_files ? ENTRY_LOAD_DOTS : 0) == -1) {
+        fprintf(stderr, "Cannot open directory: %s: %s\n", dir, strerror(errno));
+        if (dir_fd != -1) {
+            close(dir_fd);
         }
-        entries[count].type = time_type;
-        count++;
+        entry_store_free(&store);
+        return;
     }
-    closedir(dp);
+    // The sort key is all that is needed: statx asks for that one time and nothing else
+    if (entry_store_stat(&store, dir_fd, 0, time_field) == -1) {
+        fprintf(stderr, "Cannot list directory: %s: %s\n", dir, strerror(errno));
+        close(dir_fd);
+        entry_store_free(&store);
+        return;
+    }
+    close(dir_fd);
+    int count = (int)store.count;
 
     // Sort entries by the selected time type
-    qsort(entries, count, sizeof(FileEntry), compare_time);
+    entry_store_sort_by_time(&store);
     // Determine maximum widths for formatting
-    int name_width = 0;
-    for (int j = 0; j < count; j++) {
-        if (strlen(entries[j].name) > name_width) {
-            name_width = strlen(entries[j].name);
-        }
-    }
+    int name_width = entry_store_max_name_len(&store);
     name_width += 4;
+    OutBuffer out;
+    out_init(&out, STDOUT_FILENO);
     if (line_by_line) {
         for (int j = 0; j < count; j++) {
-            printf("%s\n",entries[j].name);
+            const DirEntry *entry = &store.entries[j];
+            out_bytes(&out, entry_name(&store, entry), entry->name_len);
+            out_char(&out, '\n');
         }
     } else {
         // Print entries in columns
         int cols = 80 / COLUMN_WIDTH;  // Assuming terminal width is 80 columns
         for (int i = 0; i < count; i++) {
             // Print entry with aligned columns
-            printf("%-*s", name_width, entries[i].name);
+            out_str(&out, entry_name(&store, &store.entries[i]), name_width);
             if ((i + 1) % cols == 0 || i == count - 1) {
-                printf("\n");
+                out_char(&out, '\n');
             }
         }
     }
+    out_close(&out);
+    entry_store_free(&store);
 }
 
 
@@ -521,93 +384,257 @@ static void sort_files(char token[][TOKEN_LENGTH],const char *dir, int time_type
 
 
 
-/-----------Section Contains Function Definitions Used in shell.c File------------/
+/*-----------Section Contains Function Definitions Used in shell.c File------------*/
 
-/* Function to copy a file from source to destination.
- * The 'append' flag determines if the file should be appended to.
+/* Function to copy a file from source to destination, replaced atomically (atomicfile.c) as 'opts' allows.
+ * Batched durability stages the file in 'batch', 'out' (may be NULL) receives the engine's result.
+ * Returns the strategy used (COPY_STRATEGY_UNCHANGED when skipped), or -1 after reporting the error on stderr.
  */
-void copy_file(const char *source, const char *destination, int append) {
+int copy_file(const char *source, const char *destination, const CopyOptions *opts, AtomicBatch *batch,
+              CopyResult *out) {
     int fsource, fdest;
-    ssize_t bytes_read, bytes_written;
-    char buffer[BUF_SIZE];
+    int append = opts->append;
+    CopyResult result;
+    struct stat source_st, dest_st;
+    AtomicFile af;
+    char resolved[PATH_MAX];
 
     // Open source file for reading
-    fsource = open(source, O_RDONLY);
-    if (fsource == -1) {
-        perror("opening source failed");
-        exit(EXIT_FAILURE);
+    fsource = open(source, O_RDONLY | O_CLOEXEC);
+    if (fsource == -1 || fstat(fsource, &source_st) == -1) {
+        fprintf(stderr, "mycp: %s: %s\n", source, strerror(errno));
+        if (fsource != -1) {
+            close(fsource);
+        }
+        return -1;
     }
 
-    // Determine the flags to use for opening the destination file
-    int open_flags = O_WRONLY | O_CREAT;
-    if (append) {
-        open_flags |= O_APPEND;
-    } else {
-        open_flags |= O_TRUNC;
+    // Update mode: an up to date destination is not even opened
+    int have_dest = stat(destination, &dest_st) == 0;
+    int update = opts->update != COPY_UPDATE_NONE;
+    if (update && have_dest && S_ISREG(dest_st.st_mode) && copy_unchanged(&source_st, &dest_st)) {
+        TRACE(TRACE_INFO, "Skipped %s, %s has the same size and mtime", source, destination);
+        close(fsource);
+        if (out != NULL) {
+            memset(out, 0, sizeof(*out));
+            out->strategy = COPY_STRATEGY_UNCHANGED;
+        }
+        return COPY_STRATEGY_UNCHANGED;
     }
 
-    // Open destination file
-    fdest = open(destination, open_flags, 0666);
+    // Appends and delta updates change the destination where it is, and so does writing
+    // to a FIFO or device. Anything else is written to a new file that replaces it, unless
+    // that would split hard links (the other names would keep the old data)
+    int delta = opts->update == COPY_UPDATE_DELTA && S_ISREG(source_st.st_mode) && have_dest &&
+                S_ISREG(dest_st.st_mode);
+    int keep = have_dest && S_ISREG(dest_st.st_mode) && !opts->preserve;   // mycp keeps the destination's identity
+    int in_place = append || delta || (have_dest && !S_ISREG(dest_st.st_mode)) || (keep && dest_st.st_nlink > 1);
+    fdest = -1;
+    if (!in_place) {
+        // A symlink is written through, as cp does: the file it points to is the one replaced
+        struct stat link_st;
+        if (have_dest && lstat(destination, &link_st) == 0 && S_ISLNK(link_st.st_mode) &&
+            realpath(destination, resolved) != NULL) {
+            destination = resolved;
+        }
+        // The new file keeps the mode of the one it replaces, or takes the source's for mymv
+        mode_t mode = opts->preserve ? source_st.st_mode & 07777 : have_dest ? dest_st.st_mode & 07777 : 0666;
+        if (atomic_file_open(&af, destination, mode) == -1) {
+            // No temporary file in a directory we may not write to, but the file itself may be writable
+            TRACE(TRACE_INFO, "No temporary file next to %s (%s), writing it in place", destination, strerror(errno));
+            in_place = keep;
+        } else if (keep && atomic_file_keep(&af, &dest_st) == -1) {
+            // The owner, an ACL or a label would be lost, so keep the old inode instead
+            TRACE(TRACE_INFO, "Cannot keep the owner or attributes of %s (%s), writing it in place", destination,
+                  strerror(errno));
+            atomic_file_abort(&af);
+            in_place = 1;
+        } else {
+            fdest = af.fd;
+            if (opts->preserve || have_dest) {
+                fchmod(fdest, mode);  // Not filtered by the umask, like the file being replaced
+            }
+        }
+    }
+    if (in_place) {
+        // -v reads the destination back and a delta update reads and patches it
+        int open_flags = (opts->verify || delta ? O_RDWR : O_WRONLY) | O_CREAT | O_CLOEXEC;
+        if (append) {
+            open_flags |= O_APPEND;
+        } else if (!delta) {
+            open_flags |= O_TRUNC;
+        }
+        fdest = open(destination, open_flags, 0666);
+    }
     if (fdest == -1) {
-        perror("opening destination failed");
-        exit(EXIT_FAILURE);
+        fprintf(stderr, "mycp: %s: %s\n", destination, strerror(errno));
+        close(fsource);
+        return -1;
     }
 
-    // Copy data from source to destination
-    while ((bytes_read = read(fsource, buffer, BUF_SIZE)) > 0) {
-        bytes_written = write(fdest, buffer, bytes_read);
-        if (bytes_written != bytes_read) {
-            perror("writing failed\n");
-            exit(EXIT_FAILURE);
+    // Copy data from source to destination, reflink first and the buffered loop last
+    int rc = copy_data(fsource, fdest, opts, &result);
+    if (rc == -1) {
+        fprintf(stderr, "mycp: copying %s to %s failed: %s\n", source, destination, strerror(errno));
+    } else {
+        TRACE(TRACE_INFO, "Copied %lld bytes from %s to %s using %s%s, apparent size %lld, allocated %lld",
+              (long long)result.bytes, source, destination, copy_strategy_name(result.strategy),
+              result.sparse ? " (sparse)" : "", (long long)result.apparent, (long long)result.allocated);
+    }
+    if (rc == 0 && result.strategy == COPY_STRATEGY_DELTA) {
+        TRACE(TRACE_INFO, "Delta update of %s: %lld bytes rewritten, %lld unchanged", destination,
+              (long long)result.bytes, (long long)result.unchanged);
+    }
+    if (rc == 0 && (update || opts->preserve)) {
+        struct timespec times[2] = {source_st.st_atim, source_st.st_mtim};
+        if (futimens(fdest, times) == -1) {
+            perror("setting destination times failed");
         }
     }
-
-    if (bytes_read == -1) {
-        perror("reading failed\n");
-        exit(EXIT_FAILURE);
+    if (rc == 0 && result.verified) {
+        TRACE(TRACE_INFO, "Checksum %s crc32c %08x, read back %08x", destination,
+              result.checksum, result.dest_checksum);
+        if (result.checksum != result.dest_checksum) {
+            fprintf(stderr, "mycp: %s: checksum mismatch, crc32c %08x copied but %08x read back\n",
+                    destination, result.checksum, result.dest_checksum);
+            rc = -1;
+        }
     }
+    if (rc == 0 && out != NULL) {
+        *out = result;
+    }
+    close(fsource);
 
-    // Close files
-    if (close(fsource) == -1) {
-        perror("close source failed\n");
-        exit(EXIT_FAILURE);
+    // Publish: nothing to do in place but the sync, otherwise the rename (now or with the batch)
+    if (rc == -1) {
+        if (in_place) {
+            close(fdest);
+        } else {
+            atomic_file_abort(&af);
+        }
+        return -1;
+    }
+    if (in_place) {
+        // fsync is EINVAL on pipes and character devices, there is nothing to sync there
+        if ((opts->durability != ATOMIC_DURABLE_NONE && fsync(fdest) == -1 && errno != EINVAL) ||
+            close(fdest) == -1) {
+            rc = -1;
+        }
+    } else if (opts->durability == ATOMIC_DURABLE_BATCH && batch != NULL) {
+        rc = atomic_batch_add(batch, &af);
+    } else {
+        // Batched durability without a batch to join syncs this one file instead
+        rc = atomic_file_commit(&af, opts->durability == ATOMIC_DURABLE_BATCH ? ATOMIC_DURABLE_EACH : opts->durability);
     }
+    if (rc == -1) {
+        fprintf(stderr, "mycp: %s: %s\n", destination, strerror(errno));
+        return -1;
+    }
+    return result.strategy;
+}
 
-    if (close(fdest) == -1) {
-        perror("close destination failed\n");
-        exit(EXIT_FAILURE);
+/* Last component of a path, trailing slashes ignored as by basename() ("/" stays "/").
+ * It points into 'path', unless 'path' ends in a slash: the component is then copied to 'buffer'.
+ */
+const char *path_base(const char *path, char *buffer, size_t size) {
+    size_t end = strlen(path);
+    while (end > 1 && path[end - 1] == '/') {
+        end--;
+    }
+    size_t start = end;
+    while (start > 0 && path[start - 1] != '/') {
+        start--;
+    }
+    if (start == end && end > 0) {
+        return "/";
+    }
+    if (path[end] == '\0') {
+        return path + start;
     }
+    snprintf(buffer, size, "%.*s", (int)(end - start), path + start);
+    return buffer;
 }
 
 /* Function to move a file from source to destination directory.
  * 'force' flag determines if existing files in the destination should be overwritten.
+ * Without it the rename itself refuses to replace a file (RENAME_NOREPLACE). Across
+ * file systems the file is copied, atomically and synced, with its mode and times,
+ * and the source is removed only once the copy is safe.
+ * Returns 0, or -1 after reporting the error on stderr.
  */
-void move_file(const char *source, const char *destination_dir, int force) {
+int move_file(const char *source, const char *destination_dir, int force) {
     char destination[PATH_MAX];
+    char base_buffer[NAME_MAX + 1];
+    const char *base = path_base(source, base_buffer, sizeof(base_buffer));   // "src/" moves src
 
     // Construct the full destination path
-    snprintf(destination, sizeof(destination), "%s/%s", destination_dir, basename(source));
+    snprintf(destination, sizeof(destination), "%s/%s", destination_dir, base);
+
+    // Attempt to move the file using rename, which cannot replace an existing file without -f
+    int rc = renameat2(AT_FDCWD, source, AT_FDCWD, destination, force ? 0 : RENAME_NOREPLACE);
+    if (rc == -1 && !force && (errno == EINVAL || errno == ENOSYS)) {
+        // No RENAME_NOREPLACE on this file system, check first as before
+        if (access(destination, F_OK) != -1) {
+            errno = EEXIST;
+        } else {
+            rc = rename(source, destination);
+        }
+    }
+    if (rc == 0) {
+        return 0;
+    }
+    if (errno == EEXIST) {
+        fprintf(stderr, "Error: File '%s' already exists in '%s'.\n", base, destination_dir);
+        return -1;
+    }
+    if (errno != EXDEV) {
+        fprintf(stderr, "mymv: %s: %s\n", source, strerror(errno));
+        return -1;
+    }
 
-    // Check if the destination file already exists
+    // Another file system: copy, then unlink the source
+    struct stat st;
+    if (lstat(source, &st) == -1) {
+        fprintf(stderr, "mymv: %s: %s\n", source, strerror(errno));
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        fprintf(stderr, "mymv: %s: only regular files can be moved to another file system\n", source);
+        return -1;
+    }
     if (!force && access(destination, F_OK) != -1) {
-        fprintf(stderr, "Error: File '%s' already exists in '%s'.\n", basename(source), destination_dir);
-        exit(EXIT_FAILURE);
+        fprintf(stderr, "Error: File '%s' already exists in '%s'.\n", base, destination_dir);
+        return -1;
     }
-
-    // Attempt to move the file using rename
-    if (rename(source, destination) != 0) {
-        perror("rename failed\n");
-        exit(EXIT_FAILURE);
+    CopyOptions opts;
+    copy_options_init(&opts);
+    opts.preserve = 1;
+    opts.durability = ATOMIC_DURABLE_EACH;  // The only copy must be on disk before the source goes
+    if (copy_file(source, destination, &opts, NULL, NULL) == -1) {
+        return -1;
     }
+    if (unlink(source) == -1) {
+        fprintf(stderr, "mymv: %s: copied to %s but not removed: %s\n", source, destination, strerror(errno));
+        return -1;
+    }
+    TRACE(TRACE_INFO, "Moved %s to %s by copying, it is on another file system", source, destination);
+    return 0;
 }
 
-/* Function to remove a file from the filesystem */
-void remove_file(const char *path) {
+/* Function to remove a file from the filesystem.
+ * With 'force' a file that does not exist is not an error.
+ * Returns 0, or -1 after reporting the error on stderr.
+ */
+int remove_file(const char *path, int force) {
     // Attempt to remove the file using unlink
     if (unlink(path) != 0) {
-        perror("unlink");
-        exit(EXIT_FAILURE);
+        if (force && errno == ENOENT) {
+            return 0;
+        }
+        fprintf(stderr, "myrm: %s: %s\n", path, strerror(errno));
+        return -1;
     }
+    return 0;
 }
 
 /* Function to print all environment variables */
@@ -663,7 +690,7 @@ void cd_command(const char *path) {
 }
 
 /* Function to print arguments provided to 'echo' command */
-void echo_command(int arg_count, char args[][50]) {
+void echo_command(int arg_count, char **args) {
     for (int i = 1; i < arg_count; i++) {
         if (args[i] != NULL) {
             printf("%s ", args[i]);
@@ -673,99 +700,36 @@ void echo_command(int arg_count, char args[][50]) {
 }
 
 /* Function to check if a command is internal */
-char is_internal(const char *command, const char **commands_given) {
-    for (int i = 0; i < 20; i++) { // 20 for adding more commands if needed
-        if (commands_given[i] != NULL) {
-            if (strcmp(commands_given[i], command) == 0) {
-                return 1; // Command is internal
-            }
-        } else {
-            break;
-        }
-    }
-    return 0; // Command is not internal
+char is_internal(const char *command) {
+    return builtin_lookup(command) != NULL;
 }
 
-/* Function to check if a command is external */
+/* Function to check if a command is external, resolved through the PATH cache */
 int is_external(char *command) {
     if (command == NULL) {
         fprintf(stderr, "Error: Command is NULL.\n");
         return 0; // Command is not external
     }
 
-    // Get the PATH environment variable
-    char *path_env = getenv("PATH");
-    if (path_env == NULL) {
-        fprintf(stderr, "Error: PATH environment variable is not set.\n");
-        return 0; // Command is not external
-    }
-
-    // Duplicate the PATH string to modify it
-    char *path = malloc(strlen(path_env) + 1);
-    if (path == NULL) {
-        perror("Error allocating memory for PATH");
-        return 0; // Command is not external
-    }
-    strcpy(path, path_env);
-
-    // Tokenize the PATH variable by ":" to get each directory
-    char *dir = strtok(path, ":");
-    while (dir != NULL) {
-        // Create the full path for the command in the current directory
-        char full_path[PATH_MAX];
-        snprintf(full_path, sizeof(full_path), "%s/%s", dir, command);
-
-        // Check if the command is executable in this directory
-        struct stat statbuf;
-        if (stat(full_path, &statbuf) == 0 && S_ISREG(statbuf.st_mode) && (statbuf.st_mode & S_IXUSR)) {
-            free(path); // Free the allocated memory
-            return 1; // Command is external
-        }
-
-        // Move to the next directory in PATH
-        dir = strtok(NULL, ":");
-    }
-
-    free(path); // Free the allocated memory
-    return 0; // Command is not external
+    return path_cache_resolve(command) != NULL;
 }
 
-void execute_command(char command[][TOKEN_LENGTH], int count) {
+void execute_command(char **command, int count) {
     if (count > 0) {
-        // Fork a new process to execute the command
-        pid_t pid = fork();
-        if (pid < 0) {
-            perror("Error forking");
-            return;
-        } else if (pid == 0) {
-            // Child process
-
-            // Prepare arguments for execvp
-            char *argv[count ];
-            for (int i = 0; i < count; i++) {
-                argv[i] = strdup(command[i]);  // Duplicate the command arguments
-                printf("Token[%d]: '%s'\n", i, argv[i]);  // Debugging line to check the arguments
-            }
-            argv[count] = NULL; // execvp requires a NULL-terminated array
-
-            // Print command to be executed (for debugging)
-            printf("Executing command: %s\n", argv[0]);
+        PipelineStage stage;
 
-            // Execute the command using execvp, which searches for the command in PATH
-            if (execvp(argv[0], argv) == -1) {
-                perror("Error executing command");
-            }
-
-            // If execvp returns, an error occurred
-            exit(EXIT_FAILURE);
-        } else {
-            // Parent process
-            int status;
-            waitpid(pid, &status, 0); // Wait for the child process to complete
-            if (WIFEXITED(status)) {
-                printf("Child exited with status %d\n", WEXITSTATUS(status));
-            }
+        // Trace the arguments and the command to be executed
+        for (int i = 0; i < count; i++) {
+            TRACE(TRACE_DEBUG, "Token[%d]: '%s'", i, command[i]);
         }
+        TRACE(TRACE_INFO, "Executing command: %s", command[0]);
+
+        // A plain command is a one-stage foreground pipeline, reaped by the job event loop
+        memset(&stage, 0, sizeof(stage));
+        stage.argv = command;
+        stage.argc = count;
+        int status = pipeline_run(&stage, 1, 0);
+        TRACE(TRACE_INFO, "Child exited with status %d", status);
     }
 }
 /* Function to display memory usage statistics */
@@ -863,83 +827,12 @@ void get_uptime_with_time() {
            uptime_days, uptime_hours, uptime_minutes, uptime_seconds_final);
 }
 
-/* Function to execute two commands with a pipe between them */
-void pipe_commands(char *cmd1, char *cmd2) {
-    int pipefd[2];
-    pid_t pid1, pid2;
 
-    // Create a pipe
-    if (pipe(pipefd) == -1) {
-        perror("pipe");
-        exit(EXIT_FAILURE);
-    }
-
-    // Fork the first child process
-    if ((pid1 = fork()) == -1) {
-        perror("fork");
-        exit(EXIT_FAILURE);
-    }
 
-    if (pid1 == 0) {
-        // First child process
-        close(pipefd[0]); // Close unused read end
-        dup2(pipefd[1], STDOUT_FILENO); // Redirect stdout to pipe
-        close(pipefd[1]); // Close original write end
-
-        // Tokenize and execute the first command
-        char *args1[MAX_TOKENS];
-        int i = 0;
-        char *token = strtok(cmd1, " \n");
-        while (token != NULL && i < MAX_TOKENS - 1) {
-            args1[i++] = token;
-            token = strtok(NULL, " \n");
-        }
-        args1[i] = NULL; // Null-terminate the argument list
 
-        execvp(args1[0], args1);
-        perror("execvp");
-        exit(EXIT_FAILURE);
-    }
 
-    // Fork the second child process
-    if ((pid2 = fork()) == -1) {
-        perror("fork");
-        exit(EXIT_FAILURE);
-    }
 
-    if (pid2 == 0) {
-        // Second child process
-        close(pipefd[1]); // Close unused write end
-        dup2(pipefd[0], STDIN_FILENO); // Redirect stdin to pipe
-        close(pipefd[0]); // Close original read end
-
-        // Tokenize and execute the second command
-        char *args2[MAX_TOKENS];
-        int i = 0;
-        char *token = strtok(cmd2, " \n");
-        while (token != NULL && i < MAX_TOKENS - 1) {
-            args2[i++] = token;
-            token = strtok(NULL, " \n");
-        }
-        args2[i] = NULL; // Null-terminate the argument list
-
-        execvp(args2[0], args2);
-        perror("execvp");
-        exit(EXIT_FAILURE);
-    }
-
-    // Parent process
-    close(pipefd[0]);
-    close(pipefd[1]);
-    wait(NULL); // Wait for both children to finish
-    wait(NULL);
-}
-
-
-
-
-
-void ls_command_implementation(int argc, char token[][TOKEN_LENGTH]) {
+void ls_command_implementation(int argc, char **token) {
    // Initialize variables for options and settings
     int hidden_files = 0;  // Option to show hidden files
     int line_by_line = NOLINE_BYLINE_PRINT;  // Option to print one file per line
@@ -968,31 +861,21 @@ void ls_command_implementation(int argc, char token[][TOKEN_LENGTH]) {
 
     // Step 2: Create an argv array large enough to hold individual options
     char *argv[argc + opt_count];
+    char option_storage[opt_count + 1][3];  // "-x" strings for the split options
     int argv_index = 0;
+    int option_index = 0;
 
     // Loop through each token to handle options and directory names
     for (int i = 0; i < argc; i++) {
         if (token[i][0] == '-') {
             // Split options like "-liatc" into individual arguments "-l", "-i", "-a", etc.
-            for (int j = 1; j < strlen(token[i]); j++) {
-                argv[argv_index] = (char *)malloc(3 * sizeof(char));  // Allocate memory for each option "-x"
-                if (argv[argv_index] == NULL) {
-                    fprintf(stderr, "Memory allocation failed\n");
-                    return;
-                }
-                snprintf(argv[argv_index], 3, "-%c", token[i][j]);  // Create each option argument
-                argv_index++;
+            for (int j = 1; token[i][j] != '\0'; j++) {
+                snprintf(option_storage[option_index], 3, "-%c", token[i][j]);  // Create each option argument
+                argv[argv_index++] = option_storage[option_index++];
             }
         } else {
-            // If the token is not an option, treat it as a directory/file name
-            argv[argv_index] = (char *)malloc(TOKEN_LENGTH * sizeof(char));  // Allocate memory for file/directory name
-            if (argv[argv_index] == NULL) {
-                fprintf(stderr, "Memory allocation failed\n");
-                return;
-            }
-            strncpy(argv[argv_index], token[i], TOKEN_LENGTH - 1);  // Copy the name into argv
-            argv[argv_index][TOKEN_LENGTH - 1] = '\0';  // Ensure null termination
-            argv_index++;
+            // If the token is not an option, treat it as a directory/file name (no copy needed)
+            argv[argv_index++] = token[i];
         }
     }
     // Step 3: Set the correct argc value for getopt
@@ -6,7 +6,10 @@ comment:contains all functions declarartions used in shell.c
 
 #ifndef COMMANDS_H
 #define COMMANDS_H
-/-----------------includes section--------------/
+/*-----------------includes section--------------*/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // For pipe2() and the other Linux specific calls
+#endif
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
@@ -28,7 +31,9 @@ comment:contains all functions declarartions used in shell.c
 #include <grp.h>
 #include <pwd.h>
 #include <locale.h>
-/----------------macros declarations-----------------/
+#include "copy.h"
+#include "atomicfile.h"
+/*----------------macros declarations-----------------*/
 #define INITIAL_CAPACITY 1000
 #define STDIN 0
 #define STDOUT 1
@@ -62,21 +67,21 @@ comment:contains all functions declarartions used in shell.c
 #define LINE_BYLINE_PRINT		 1
 #define NOLINE_BYLINE_PRINT		 0
 #define COLUMN_WIDTH 			 20
-#define MAX_ENTRIES 			 1000
-/-------------------extern variables------------------/
+/*-------------------extern variables------------------*/
 extern char **environ;
-/-----------section contains functions declarations used inshell.c file------------/
-void copy_file(const char *source, const char *destination, int append);
-void move_file(const char *source, const char *destination_dir,int force);
-void remove_file(const char *path) ;
+/*-----------section contains functions declarations used inshell.c file------------*/
+int copy_file(const char *source, const char *destination, const CopyOptions *opts, AtomicBatch *batch,
+              CopyResult *out);
+int move_file(const char *source, const char *destination_dir,int force);
+const char *path_base(const char *path, char *buffer, size_t size);
+int remove_file(const char *path, int force);
 void env_command();
 void cd_command(const char *path);
-char is_internal(const char *command,const char **commands_given);
+char is_internal(const char *command);
 int is_external(char *command);
-void execute_command(char command[][TOKEN_LENGTH],int count);
-void echo_command(int arg_count, char args[][50]);
+void execute_command(char **command,int count);
+void echo_command(int arg_count, char **args);
 void free_command();
 void get_uptime_with_time();
-void pipe_commands(char *cmd1, char *cmd2);
-void ls_command_implementation(int argc, char token[][TOKEN_LENGTH]) ; 
+void ls_command_implementation(int argc, char **token) ; 
 #endif
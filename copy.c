@@ -0,0 +1,819 @@
+/*
+Author: Assem Samy
+File: copy.c
+Comment: Tiered copy engine, FICLONE -> copy_file_range -> sendfile -> buffered read/write
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "copy.h"
+#include "checksum.h"
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>   // FICLONE
+
+/*-----------------variables and static functions---------------*/
+static const char *strategy_names[COPY_STRATEGY_COUNT] = {
+    "reflink", "copy_file_range", "sendfile", "read/write", "delta", "unchanged", "read/write pipeline"
+};
+
+/* Shared by the threads of one chunked copy, each one claims the next range */
+typedef struct {
+    int in_fd;
+    int out_fd;
+    off_t size;
+    off_t chunk_size;
+    off_t next;           // Offset of the next unclaimed range
+    int buffered;         // Set once copy_file_range is refused, every thread then uses pread/pwrite
+    int error;            // First errno seen, stops the other threads
+    size_t buffer_size;
+} RangeCopy;
+
+/* Live progress on stderr (mycp -g), updated by whichever tier does the copy */
+typedef struct {
+    off_t total;          // Bytes expected, 0 when not known (pipes, devices)
+    off_t done;
+    double start;
+    double last;          // When a line was last printed
+} CopyProgress;
+
+/* One buffer of the ring shared by the reader thread and the writer */
+typedef struct {
+    char *buffer;
+    size_t len;
+} RingSlot;
+
+typedef struct {
+    int in_fd;
+    size_t size;                 // Bytes per slot
+    RingSlot slots[COPY_RING_SLOTS];
+    unsigned long filled;        // Slots handed to the writer so far
+    unsigned long drained;       // Slots the writer gave back
+    int eof;                     // The reader is done, at end of input or on an error
+    int stop;                    // The writer failed, the reader must not wait for room
+    int error;                   // errno of a failed read
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} CopyRing;
+
+static double progress_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void format_size(char *out, size_t len, double bytes) {
+    const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    int unit = 0;
+    while (bytes >= 1024 && unit < 4) {
+        bytes /= 1024;
+        unit++;
+    }
+    snprintf(out, len, unit == 0 ? "%.0f %s" : "%.1f %s", bytes, units[unit]);
+}
+
+static void progress_print(CopyProgress *p, double now, int final) {
+    char done[32], total[32], rate[32];
+    double elapsed = now - p->start;
+    double speed = elapsed > 0 ? p->done / elapsed : 0;
+
+    format_size(done, sizeof(done), p->done);
+    format_size(rate, sizeof(rate), speed);
+    // Trailing blanks cover the end of a longer previous line
+    if (final) {
+        fprintf(stderr, "\rmycp: %s in %.1fs, %s/s%20s\n", done, elapsed, rate, "");
+    } else if (p->total > 0) {
+        long eta = speed > 0 ? (long)((p->total - p->done) / speed) : 0;
+        format_size(total, sizeof(total), p->total);
+        fprintf(stderr, "\rmycp: %s of %s (%d%%), %s/s, ETA %ld:%02ld   ", done, total,
+                (int)(100.0 * p->done / p->total), rate, eta / 60, eta % 60);
+    } else {
+        fprintf(stderr, "\rmycp: %s, %s/s   ", done, rate);
+    }
+    p->last = now;
+}
+
+/* Count 'bytes' more; a line is printed at most every COPY_PROGRESS_INTERVAL, the
+ * clock read in between is a vDSO call, not a system call. 'p' may be NULL */
+static void progress_update(CopyProgress *p, off_t bytes) {
+    if (p == NULL) {
+        return;
+    }
+    p->done += bytes;
+    double now = progress_now();
+    if (now - p->last >= COPY_PROGRESS_INTERVAL) {
+        progress_print(p, now, 0);
+    }
+}
+
+/* Errors meaning "this tier does not work for these two files", the next tier is tried */
+static int tier_unsupported(int err) {
+    return err == EXDEV || err == EOPNOTSUPP || err == EINVAL || err == ENOSYS ||
+           err == EBADF || err == ETXTBSY;
+}
+
+/* Copy from the current offsets of both descriptors with copy_file_range or sendfile.
+ * Returns 0 at end of input, 1 if the tier cannot be used (offsets stay where the copy
+ * stopped, so the next tier carries on from there) and -1 on a real error.
+ */
+static int offload_loop(int strategy, int in_fd, int out_fd, off_t *copied, CopyProgress *progress) {
+    off_t tier_bytes = 0;
+    size_t chunk = progress != NULL ? COPY_PROGRESS_CHUNK : COPY_CHUNK_SIZE;
+
+    while (1) {
+        ssize_t n;
+        if (strategy == COPY_STRATEGY_RANGE) {
+            n = copy_file_range(in_fd, NULL, out_fd, NULL, chunk, 0);
+        } else {
+            n = sendfile(out_fd, in_fd, NULL, chunk);
+        }
+
+        if (n > 0) {
+            tier_bytes += n;
+            *copied += n;
+            progress_update(progress, n);
+            continue;
+        }
+        if (n == 0) {
+            // Files like those in /proc report size 0 and copy nothing here, let read() decide
+            return tier_bytes > 0 ? 0 : 1;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return tier_unsupported(errno) ? 1 : -1;
+    }
+}
+
+/* COPY_BUFFER_SIZE rounded up to a multiple of both files' preferred I/O size */
+static size_t buffer_size_for(const struct stat *in_st, const struct stat *out_st) {
+    size_t block = in_st->st_blksize > out_st->st_blksize ? in_st->st_blksize : out_st->st_blksize;
+    size_t size = COPY_BUFFER_SIZE;
+    if (block > 0) {
+        size = (size + block - 1) / block * block;
+    }
+    return size;
+}
+
+/* write() all of 'len', it may take less than asked on pipes and sockets */
+static int write_all(int fd, const char *buffer, size_t len) {
+    for (size_t done = 0; done < len;) {
+        ssize_t n = write(fd, buffer + done, len - done);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+/* Reader side of a pipelined copy: fill free slots until end of input */
+static void *ring_reader(void *arg) {
+    CopyRing *ring = arg;
+
+    while (1) {
+        pthread_mutex_lock(&ring->lock);
+        while (ring->filled - ring->drained == COPY_RING_SLOTS && !ring->stop) {
+            pthread_cond_wait(&ring->cond, &ring->lock);
+        }
+        if (ring->stop) {
+            pthread_mutex_unlock(&ring->lock);
+            return NULL;
+        }
+        RingSlot *slot = &ring->slots[ring->filled % COPY_RING_SLOTS];
+        pthread_mutex_unlock(&ring->lock);
+
+        ssize_t n;
+        do {
+            n = read(ring->in_fd, slot->buffer, ring->size);
+        } while (n == -1 && errno == EINTR);
+
+        pthread_mutex_lock(&ring->lock);
+        if (n > 0) {
+            slot->len = n;
+            ring->filled++;
+        } else {
+            ring->error = (n == -1) ? errno : 0;
+            ring->eof = 1;
+        }
+        pthread_cond_broadcast(&ring->cond);
+        pthread_mutex_unlock(&ring->lock);
+        if (n <= 0) {
+            return NULL;
+        }
+    }
+}
+
+/* Set or clear O_DIRECT, returns 0 if the file system took it */
+static int set_direct(int fd, int on) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, on ? flags | O_DIRECT : flags & ~O_DIRECT);
+}
+
+/* Reading and writing overlap: a reader thread fills a ring of COPY_RING_SLOTS aligned
+ * buffers while this thread writes the filled ones, so a slow source (network mount,
+ * FUSE, pipe) and a slow destination wait at the same time instead of in turn.
+ * With 'direct' both regular files bypass the page cache; the last, unaligned block
+ * is written with O_DIRECT cleared, as the kernel requires */
+static int pipelined_loop(int in_fd, int out_fd, int direct, off_t *copied, unsigned int *crc,
+                          CopyProgress *progress) {
+    CopyRing ring;
+    pthread_t reader;
+    int rc = 0;
+
+    memset(&ring, 0, sizeof(ring));
+    ring.in_fd = in_fd;
+    ring.size = COPY_RING_SLOT_SIZE;
+    for (int k = 0; k < COPY_RING_SLOTS; k++) {
+        if (posix_memalign((void **)&ring.slots[k].buffer, COPY_DIRECT_ALIGN, ring.size) != 0) {
+            for (int j = 0; j < k; j++) {
+                free(ring.slots[j].buffer);
+            }
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    // O_DIRECT only where both files take it, both offsets start aligned
+    int in_direct = direct && set_direct(in_fd, 1) == 0;
+    int out_direct = in_direct && set_direct(out_fd, 1) == 0;
+    if (in_direct && !out_direct) {
+        set_direct(in_fd, 0);
+        in_direct = 0;
+    }
+    pthread_mutex_init(&ring.lock, NULL);
+    pthread_cond_init(&ring.cond, NULL);
+
+    int started = pthread_create(&reader, NULL, ring_reader, &ring) == 0;
+    if (!started) {
+        errno = EAGAIN;
+        rc = -1;
+    }
+    while (rc == 0) {
+        pthread_mutex_lock(&ring.lock);
+        while (ring.filled == ring.drained && !ring.eof) {
+            pthread_cond_wait(&ring.cond, &ring.lock);
+        }
+        if (ring.filled == ring.drained) {
+            pthread_mutex_unlock(&ring.lock);
+            break;  // Reader is done and every slot is written
+        }
+        RingSlot *slot = &ring.slots[ring.drained % COPY_RING_SLOTS];
+        pthread_mutex_unlock(&ring.lock);
+
+        if (out_direct && slot->len % COPY_DIRECT_ALIGN != 0) {
+            set_direct(out_fd, 0);  // Only the short last block can be unaligned
+            out_direct = 0;
+        }
+        if (write_all(out_fd, slot->buffer, slot->len) == -1) {
+            rc = -1;
+            break;
+        }
+        if (crc != NULL) {
+            *crc = crc32c_update(*crc, slot->buffer, slot->len);
+        }
+        *copied += slot->len;
+        progress_update(progress, slot->len);
+
+        pthread_mutex_lock(&ring.lock);
+        ring.drained++;
+        pthread_cond_broadcast(&ring.cond);
+        pthread_mutex_unlock(&ring.lock);
+    }
+
+    int err = errno;
+    if (started) {
+        // Wakes a reader still waiting for room after a write error
+        pthread_mutex_lock(&ring.lock);
+        ring.stop = 1;
+        pthread_cond_broadcast(&ring.cond);
+        pthread_mutex_unlock(&ring.lock);
+        pthread_join(reader, NULL);
+    }
+    if (rc == 0 && ring.error != 0) {
+        err = ring.error;
+        rc = -1;
+    }
+    if (in_direct) {
+        set_direct(in_fd, 0);
+    }
+    if (out_direct) {
+        set_direct(out_fd, 0);
+    }
+    pthread_mutex_destroy(&ring.lock);
+    pthread_cond_destroy(&ring.cond);
+    for (int k = 0; k < COPY_RING_SLOTS; k++) {
+        free(ring.slots[k].buffer);
+    }
+    errno = err;
+    return rc;
+}
+
+/* Last tier: read/write through a heap buffer sized to a multiple of both block sizes.
+ * Large or unknown-size inputs go through pipelined_loop() instead, so that reads and
+ * writes overlap. With 'crc' set, every block is added to a CRC32C while it is still
+ * in the buffer. Sets result->strategy to the loop used */
+static int buffered_loop(int in_fd, int out_fd, const struct stat *in_st, const struct stat *out_st,
+                         const CopyOptions *opts, CopyResult *result, unsigned int *crc, CopyProgress *progress) {
+    off_t *copied = &result->bytes;
+
+    if (!S_ISREG(in_st->st_mode) || in_st->st_size >= COPY_PIPELINE_MIN) {
+        // O_DIRECT needs aligned offsets, so not for appends or sources not read from the start
+        int direct = opts->direct && !opts->append && S_ISREG(in_st->st_mode) && S_ISREG(out_st->st_mode) &&
+                     lseek(in_fd, 0, SEEK_CUR) == 0 && lseek(out_fd, 0, SEEK_CUR) == 0;
+        result->strategy = COPY_STRATEGY_PIPELINED;
+        return pipelined_loop(in_fd, out_fd, direct, copied, crc, progress);
+    }
+
+    size_t size = buffer_size_for(in_st, out_st);
+    char *buffer = malloc(size);
+    if (buffer == NULL) {
+        return -1;
+    }
+    result->strategy = COPY_STRATEGY_BUFFERED;
+
+    ssize_t bytes_read;
+    while ((bytes_read = read(in_fd, buffer, size)) != 0) {
+        if (bytes_read == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            free(buffer);
+            return -1;
+        }
+        if (write_all(out_fd, buffer, bytes_read) == -1) {
+            free(buffer);
+            return -1;
+        }
+        if (crc != NULL) {
+            *crc = crc32c_update(*crc, buffer, bytes_read);
+        }
+        *copied += bytes_read;
+        progress_update(progress, bytes_read);
+    }
+    free(buffer);
+    return 0;
+}
+
+/* CRC32C of [offset, offset + len) of a file just written. The range is flushed and
+ * dropped from the page cache first, so it is read back from the device and not from
+ * the pages the copy itself filled */
+static int checksum_written(int fd, off_t offset, off_t len, size_t size, unsigned int *crc) {
+    char *buffer = malloc(size);
+    if (buffer == NULL) {
+        return -1;
+    }
+    fdatasync(fd);   // Fails harmlessly on pipes and character devices, which are not read back anyway
+    posix_fadvise(fd, offset, len, POSIX_FADV_DONTNEED);
+
+    *crc = CRC32C_INIT;
+    while (len > 0) {
+        ssize_t n = pread(fd, buffer, len < (off_t)size ? (size_t)len : size, offset);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            free(buffer);
+            if (n == 0) {
+                errno = EIO;   // The destination is shorter than what was written to it
+            }
+            return -1;
+        }
+        *crc = crc32c_update(*crc, buffer, n);
+        offset += n;
+        len -= n;
+    }
+    free(buffer);
+    return 0;
+}
+
+/* mycp -v: one sequential pass through the buffered loop, the kernel offloads never
+ * show the data to user space. The destination is then read back (only the bytes of
+ * this copy, so append mode works too) and both CRCs are left in 'result'.
+ * out_fd must be open for reading as well */
+static int copy_verified(int in_fd, int out_fd, const CopyOptions *opts, CopyResult *result,
+                         CopyProgress *progress) {
+    struct stat in_st, out_st;
+
+    if (fstat(in_fd, &in_st) == -1 || fstat(out_fd, &out_st) == -1) {
+        return -1;
+    }
+    if (!S_ISREG(out_st.st_mode)) {
+        errno = EINVAL;   // A pipe or terminal cannot be read back
+        return -1;
+    }
+    off_t start = opts->append ? out_st.st_size : lseek(out_fd, 0, SEEK_CUR);
+    if (start == -1) {
+        return -1;
+    }
+
+    result->checksum = CRC32C_INIT;
+    if (buffered_loop(in_fd, out_fd, &in_st, &out_st, opts, result, &result->checksum, progress) == -1 ||
+        checksum_written(out_fd, start, result->bytes, buffer_size_for(&in_st, &out_st),
+                         &result->dest_checksum) == -1) {
+        return -1;
+    }
+    result->verified = 1;
+    return 0;
+}
+
+/* Copy [offset, offset + len) with pread/pwrite, the descriptors' own offsets are not used */
+static int copy_range_buffered(RangeCopy *rc, char *buffer, off_t offset, off_t len) {
+    while (len > 0) {
+        size_t want = len < (off_t)rc->buffer_size ? (size_t)len : rc->buffer_size;
+        ssize_t n = pread(rc->in_fd, buffer, want, offset);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return n == 0 ? 0 : -1;  // 0: the source shrank while we copied
+        }
+        for (ssize_t done = 0; done < n;) {
+            ssize_t w = pwrite(rc->out_fd, buffer + done, n - done, offset + done);
+            if (w == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            done += w;
+        }
+        offset += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Copy one range in the kernel, switching the whole copy to pread/pwrite if refused */
+static int copy_range(RangeCopy *rc, char **buffer, off_t offset, off_t len) {
+    while (len > 0 && !__atomic_load_n(&rc->buffered, __ATOMIC_RELAXED)) {
+        loff_t off_in = offset;
+        loff_t off_out = offset;
+        ssize_t n = copy_file_range(rc->in_fd, &off_in, rc->out_fd, &off_out, len, 0);
+        if (n > 0) {
+            offset += n;
+            len -= n;
+            continue;
+        }
+        if (n == 0) {
+            return 0;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (!tier_unsupported(errno)) {
+            return -1;
+        }
+        __atomic_store_n(&rc->buffered, 1, __ATOMIC_RELAXED);
+    }
+    if (len == 0) {
+        return 0;
+    }
+    if (*buffer == NULL && (*buffer = malloc(rc->buffer_size)) == NULL) {
+        return -1;
+    }
+    return copy_range_buffered(rc, *buffer, offset, len);
+}
+
+static void *range_worker(void *arg) {
+    RangeCopy *rc = arg;
+    char *buffer = NULL;
+
+    while (__atomic_load_n(&rc->error, __ATOMIC_RELAXED) == 0) {
+        off_t offset = __atomic_fetch_add(&rc->next, rc->chunk_size, __ATOMIC_RELAXED);
+        if (offset >= rc->size) {
+            break;
+        }
+        off_t len = rc->size - offset < rc->chunk_size ? rc->size - offset : rc->chunk_size;
+        if (copy_range(rc, &buffer, offset, len) == -1) {
+            int expected = 0;
+            __atomic_compare_exchange_n(&rc->error, &expected, errno, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    free(buffer);
+    return NULL;
+}
+
+/* mycp -j: the destination is sized up front with fallocate, then 'threads' threads
+ * copy chunk_size ranges at explicit offsets until the file is done.
+ */
+static int copy_chunked(int in_fd, int out_fd, const struct stat *in_st, const struct stat *out_st,
+                        const CopyOptions *opts, CopyResult *result) {
+    RangeCopy rc;
+    int threads = opts->threads > COPY_PARALLEL_MAX_THREADS ? COPY_PARALLEL_MAX_THREADS : opts->threads;
+
+    memset(&rc, 0, sizeof(rc));
+    rc.in_fd = in_fd;
+    rc.out_fd = out_fd;
+    rc.size = in_st->st_size;
+    rc.chunk_size = opts->chunk_size > 0 ? opts->chunk_size : COPY_PARALLEL_CHUNK;
+    rc.buffer_size = buffer_size_for(in_st, out_st);
+
+    // Reserve every block now: no allocation races between threads, and ENOSPC shows up at once
+    if (fallocate(out_fd, 0, 0, rc.size) == -1) {
+        if (errno != EOPNOTSUPP && errno != ENOSYS) {
+            return -1;
+        }
+        if (ftruncate(out_fd, rc.size) == -1) {
+            return -1;
+        }
+    }
+
+    pthread_t ids[COPY_PARALLEL_MAX_THREADS];
+    int started = 0;
+    for (int k = 0; k < threads; k++) {
+        if (pthread_create(&ids[k], NULL, range_worker, &rc) != 0) {
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        range_worker(&rc);
+    }
+    for (int k = 0; k < started; k++) {
+        pthread_join(ids[k], NULL);
+    }
+    if (rc.error != 0) {
+        errno = rc.error;
+        return -1;
+    }
+
+    // The offsets were never used, leave them at the end like a sequential copy would
+    lseek(in_fd, rc.size, SEEK_SET);
+    lseek(out_fd, rc.size, SEEK_SET);
+    result->strategy = rc.buffered ? COPY_STRATEGY_BUFFERED : COPY_STRATEGY_RANGE;
+    result->bytes = rc.size;
+    return 0;
+}
+
+/* Copy only the data extents of a sparse file, found with SEEK_DATA/SEEK_HOLE.
+ * Holes are never written, so they stay holes in the destination, and a final
+ * ftruncate recreates a hole at the end. Extents go through copy_range().
+ */
+static int copy_sparse(int in_fd, int out_fd, const struct stat *in_st, const struct stat *out_st, CopyResult *result) {
+    RangeCopy rc;
+    char *buffer = NULL;
+    off_t data = 0;
+
+    memset(&rc, 0, sizeof(rc));
+    rc.in_fd = in_fd;
+    rc.out_fd = out_fd;
+    rc.size = in_st->st_size;
+    rc.buffer_size = buffer_size_for(in_st, out_st);
+
+    while (data < rc.size) {
+        data = lseek(in_fd, data, SEEK_DATA);
+        if (data == -1) {
+            if (errno == ENXIO) {
+                break;  // Only a hole is left
+            }
+            free(buffer);
+            return -1;
+        }
+        off_t hole = lseek(in_fd, data, SEEK_HOLE);
+        if (hole == -1) {
+            free(buffer);
+            return -1;
+        }
+        if (copy_range(&rc, &buffer, data, hole - data) == -1) {
+            free(buffer);
+            return -1;
+        }
+        result->bytes += hole - data;
+        data = hole;
+    }
+    free(buffer);
+
+    if (ftruncate(out_fd, rc.size) == -1) {
+        return -1;
+    }
+    lseek(in_fd, rc.size, SEEK_SET);
+    lseek(out_fd, rc.size, SEEK_SET);
+    result->strategy = rc.buffered ? COPY_STRATEGY_BUFFERED : COPY_STRATEGY_RANGE;
+    result->sparse = 1;
+    return 0;
+}
+
+/* pread until 'len' bytes or end of file, returns the count or -1 */
+static ssize_t read_block(int fd, char *buffer, size_t len, off_t offset) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = pread(fd, buffer + got, len - got, offset + got);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1) {
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        got += n;
+    }
+    return got;
+}
+
+/* Update mode on a destination holding an older version: both files are read one
+ * COPY_DELTA_BLOCK at a time and only the blocks that differ are written, in place,
+ * then the destination is cut to the source size. A mostly unchanged file costs
+ * reads only, and its unchanged extents stay shared on reflink file systems */
+static int copy_delta(int in_fd, int out_fd, const struct stat *in_st, CopyResult *result) {
+    char *src = malloc(COPY_DELTA_BLOCK);
+    char *dst = malloc(COPY_DELTA_BLOCK);
+    if (src == NULL || dst == NULL) {
+        free(src);
+        free(dst);
+        return -1;
+    }
+    posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(out_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    int rc = 0;
+    for (off_t offset = 0; offset < in_st->st_size; offset += COPY_DELTA_BLOCK) {
+        ssize_t n = read_block(in_fd, src, COPY_DELTA_BLOCK, offset);
+        if (n <= 0) {
+            rc = n;   // -1, or the source shrank while being copied and 0 ends the loop
+            break;
+        }
+        ssize_t m = read_block(out_fd, dst, n, offset);
+        if (m == -1) {
+            rc = -1;
+            break;
+        }
+        if (m == n && memcmp(src, dst, n) == 0) {
+            result->unchanged += n;
+            continue;
+        }
+        for (ssize_t done = 0; done < n;) {
+            ssize_t w = pwrite(out_fd, src + done, n - done, offset + done);
+            if (w == -1 && errno == EINTR) {
+                continue;
+            }
+            if (w == -1) {
+                rc = -1;
+                break;
+            }
+            done += w;
+        }
+        if (rc == -1) {
+            break;
+        }
+        result->bytes += n;
+    }
+    free(src);
+    free(dst);
+    if (rc == -1 || ftruncate(out_fd, result->bytes + result->unchanged) == -1) {
+        return -1;
+    }
+    result->strategy = COPY_STRATEGY_DELTA;
+    return 0;
+}
+
+/* Pick the cheapest way that works, see copy_data() */
+static int copy_with_best_tier(int in_fd, int out_fd, const CopyOptions *opts, CopyResult *result,
+                               CopyProgress *progress) {
+    struct stat in_st, out_st;
+    int append = opts->append;
+
+    if (fstat(in_fd, &in_st) == -1 || fstat(out_fd, &out_st) == -1) {
+        return -1;
+    }
+    // Positional copies (sparse, chunked) need a fresh destination and the source at offset 0
+    int positional = !append && S_ISREG(in_st.st_mode) && S_ISREG(out_st.st_mode) &&
+                     out_st.st_size == 0 && lseek(in_fd, 0, SEEK_CUR) == 0;
+
+    // A delta copy patches an existing destination, which the caller opened without O_TRUNC
+    if (opts->update == COPY_UPDATE_DELTA && !append && S_ISREG(in_st.st_mode) && S_ISREG(out_st.st_mode) &&
+        out_st.st_size > 0 && lseek(in_fd, 0, SEEK_CUR) == 0) {
+        return copy_delta(in_fd, out_fd, &in_st, result);
+    }
+
+    if (positional && ioctl(out_fd, FICLONE, in_fd) == 0) {
+        result->strategy = COPY_STRATEGY_CLONE;
+        result->bytes = in_st.st_size;
+        return 0;
+    }
+
+    // Fewer blocks than the size needs means holes; also checked before -j, whose fallocate would fill them
+    if (positional && (off_t)in_st.st_blocks * 512 < in_st.st_size) {
+        return copy_sparse(in_fd, out_fd, &in_st, &out_st, result);
+    }
+
+    if (positional && opts->threads > 1 && in_st.st_size >= 2 * opts->chunk_size) {
+        return copy_chunked(in_fd, out_fd, &in_st, &out_st, opts, result);
+    }
+
+    for (int strategy = append ? COPY_STRATEGY_SENDFILE : COPY_STRATEGY_RANGE;
+         strategy < COPY_STRATEGY_BUFFERED; strategy++) {
+        int rc = offload_loop(strategy, in_fd, out_fd, &result->bytes, progress);
+        if (rc == 0) {
+            result->strategy = strategy;
+            return 0;
+        }
+        if (rc == -1) {
+            return -1;
+        }
+    }
+
+    return buffered_loop(in_fd, out_fd, &in_st, &out_st, opts, result, NULL, progress);
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Default options: replace the destination, one thread */
+void copy_options_init(CopyOptions *opts) {
+    opts->append = 0;
+    opts->threads = 1;
+    opts->chunk_size = COPY_PARALLEL_CHUNK;
+    opts->verify = 0;
+    opts->update = COPY_UPDATE_NONE;
+    opts->preserve = 0;
+    opts->durability = 0;   // ATOMIC_DURABLE_NONE
+    opts->direct = 0;
+    opts->progress = 0;
+}
+
+/* Copy everything from in_fd's current offset to out_fd, trying the cheapest way first:
+ *  1. FICLONE shares the source extents (btrfs, XFS, bcachefs), no data moves at all.
+ *     Only used when the destination was just truncated, never in append mode.
+ *  2. copy_file_range copies inside the kernel, or on the server for NFS/SMB.
+ *     It refuses O_APPEND destinations, so append mode starts at sendfile.
+ *  3. sendfile, still in-kernel through the page cache.
+ *  4. read/write through a buffer of at least COPY_BUFFER_SIZE bytes.
+ * A source with holes is copied extent by extent so the holes stay holes.
+ * With opts->threads > 1, a regular file of at least two ranges that could not be
+ * cloned is copied by that many threads, one range at a time (copy_file_range, or
+ * pread/pwrite). Append mode always copies sequentially. 'opts' may be NULL for defaults.
+ * With opts->verify the copy goes through the buffer, is CRC32C'd on the way and the
+ * destination is read back; the caller compares result->checksum and dest_checksum.
+ * With opts->update == COPY_UPDATE_DELTA and a non-empty destination (not truncated by
+ * the caller) only the blocks that differ are rewritten.
+ * The read/write loop is pipelined over reader and writer threads for inputs of at
+ * least COPY_PIPELINE_MIN or of unknown size (opts->direct adds O_DIRECT there), and
+ * opts->progress prints throughput and ETA on stderr.
+ * Returns 0 with the strategy, byte count and the destination's apparent and
+ * allocated sizes in 'result', or -1 with errno set.
+ */
+int copy_data(int in_fd, int out_fd, const CopyOptions *opts, CopyResult *result) {
+    CopyOptions defaults;
+    struct stat out_st;
+
+    if (opts == NULL) {
+        copy_options_init(&defaults);
+        opts = &defaults;
+    }
+    memset(result, 0, sizeof(*result));
+
+    // Only the pipelined, buffered and offload loops report progress as they go, the
+    // others (reflink, sparse, threaded) just get the final line
+    CopyProgress progress;
+    struct stat in_st;
+    if (opts->progress) {
+        memset(&progress, 0, sizeof(progress));
+        off_t offset = lseek(in_fd, 0, SEEK_CUR);
+        if (fstat(in_fd, &in_st) == 0 && S_ISREG(in_st.st_mode) && offset >= 0 && in_st.st_size > offset) {
+            progress.total = in_st.st_size - offset;
+        }
+        progress.start = progress.last = progress_now();
+    }
+    CopyProgress *p = opts->progress ? &progress : NULL;
+
+    int rc = opts->verify ? copy_verified(in_fd, out_fd, opts, result, p)
+                          : copy_with_best_tier(in_fd, out_fd, opts, result, p);
+    if (p != NULL) {
+        progress.done = result->bytes;
+        progress_print(&progress, progress_now(), 1);
+    }
+    if (rc == -1) {
+        return -1;
+    }
+    if (fstat(out_fd, &out_st) == 0) {
+        result->apparent = out_st.st_size;
+        result->allocated = (off_t)out_st.st_blocks * 512;
+    }
+    return 0;
+}
+
+const char *copy_strategy_name(int strategy) {
+    if (strategy < 0 || strategy >= COPY_STRATEGY_COUNT) {
+        return "unknown";
+    }
+    return strategy_names[strategy];
+}
+
+/* The update-mode gate: same size and same mtime means the destination is current.
+ * Nanoseconds only count when both file systems keep them */
+int copy_unchanged(const struct stat *source, const struct stat *destination) {
+    if (source->st_size != destination->st_size || source->st_mtim.tv_sec != destination->st_mtim.tv_sec) {
+        return 0;
+    }
+    return source->st_mtim.tv_nsec == destination->st_mtim.tv_nsec ||
+           source->st_mtim.tv_nsec == 0 || destination->st_mtim.tv_nsec == 0;
+}
@@ -0,0 +1,65 @@
+/*
+Author: Assem Samy
+File: copy.h
+Comment: Copy engine used by mycp, tries the kernel offloads first and falls back to a buffered loop
+*/
+
+#ifndef COPY_H
+#define COPY_H
+/*-----------------includes section--------------*/
+#include <sys/types.h>
+#include <sys/stat.h>
+/*----------------macros declarations-----------------*/
+#define COPY_STRATEGY_CLONE     0   // FICLONE reflink, no data is copied at all
+#define COPY_STRATEGY_RANGE     1   // copy_file_range, in-kernel (or server-side) copy
+#define COPY_STRATEGY_SENDFILE  2   // sendfile, in-kernel copy through the page cache
+#define COPY_STRATEGY_BUFFERED  3   // read/write loop through a userspace buffer
+#define COPY_STRATEGY_DELTA     4   // Only the blocks that differ from the existing destination are written
+#define COPY_STRATEGY_UNCHANGED 5   // Update mode found the same size and mtime, nothing was copied
+#define COPY_STRATEGY_PIPELINED 6   // Reader and writer threads overlapping over a ring of buffers
+#define COPY_STRATEGY_COUNT     7
+#define COPY_BUFFER_SIZE   (128 * 1024)   // Smallest buffered-loop buffer, rounded up to st_blksize
+#define COPY_CHUNK_SIZE    (1L << 30)     // Bytes asked for per copy_file_range / sendfile call
+#define COPY_PARALLEL_CHUNK (32L << 20)   // Default range handed to one thread at a time by mycp -j
+#define COPY_PARALLEL_MAX_THREADS 64
+#define COPY_DELTA_BLOCK   (64 * 1024)    // Unit compared, and rewritten when different, by delta copies
+#define COPY_RING_SLOTS    4              // Buffers shared by the reader and writer threads of a pipelined copy
+#define COPY_RING_SLOT_SIZE (1L << 20)    // Bytes per ring buffer, a multiple of any O_DIRECT alignment
+#define COPY_DIRECT_ALIGN  4096           // Buffer, offset and length alignment O_DIRECT asks for
+#define COPY_PIPELINE_MIN  (4L << 20)     // Smaller regular files are not worth a second thread
+#define COPY_PROGRESS_INTERVAL 0.25       // Seconds between progress lines, so printing stays cheap
+#define COPY_PROGRESS_CHUNK (64L << 20)   // Offload call size while progress is shown, so it moves
+#define COPY_UPDATE_NONE   0              // Always copy everything
+#define COPY_UPDATE_QUICK  1              // Skip files whose size and mtime match, copy the others whole
+#define COPY_UPDATE_DELTA  2              // Same skip, changed files are patched in place block by block
+/*-----------------types declarations-----------------*/
+typedef struct {
+    int append;        // Add to the end of the destination instead of replacing it
+    int threads;       // More than 1 copies a large file as ranges on that many threads
+    off_t chunk_size;  // Range size for threaded copies
+    int verify;        // CRC32C the data in the copy buffer, then read the destination back and compare
+    int update;        // COPY_UPDATE_*, the destination is kept when it already matches
+    int preserve;      // copy_file(): give the copy the source's mode and times (mymv across file systems)
+    int durability;    // copy_file(): ATOMIC_DURABLE_* (atomicfile.h), when the replacement must be on disk
+    int direct;        // Pipelined copies of regular files use O_DIRECT, bypassing the page cache
+    int progress;      // Print bytes copied, throughput and ETA on stderr while copying
+} CopyOptions;
+
+typedef struct {
+    int strategy;      // COPY_STRATEGY_* that finished the copy
+    off_t bytes;       // Bytes copied (the file size for a reflink, data extents only for a sparse copy,
+                       // rewritten blocks only for a delta copy)
+    off_t unchanged;   // Delta copies: bytes already equal in the destination and left alone
+    int sparse;        // Set when holes in the source were skipped and recreated
+    off_t apparent;    // Destination st_size after the copy
+    off_t allocated;   // Destination st_blocks in bytes after the copy
+    int verified;      // Set when 'checksum' and 'dest_checksum' were computed (opts->verify)
+    unsigned int checksum;       // CRC32C of the source data, taken from the copy buffer
+    unsigned int dest_checksum;  // CRC32C of the same range read back from the destination
+} CopyResult;
+/*-----------section contains functions declarations------------*/
+void copy_options_init(CopyOptions *opts);
+int copy_data(int in_fd, int out_fd, const CopyOptions *opts, CopyResult *result);
+const char *copy_strategy_name(int strategy);
+int copy_unchanged(const struct stat *source, const struct stat *destination);
+#endif
@@ -0,0 +1,450 @@
+/*
+Author: Assem Samy
+File: copytree.c
+Comment: mycp -r, directories are scanned and files copied by a pool of threads, all relative to open directory fds
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "copytree.h"
+#include "copy.h"
+#include "trace.h"
+#include <pthread.h>
+
+/*-----------------types and static functions---------------*/
+
+/* A directory being copied. It stays open while any of its entries is still queued,
+ * so workers open entries with openat() instead of resolving the whole path again.
+ */
+typedef struct DirNode {
+    struct DirNode *parent;
+    DIR *src;              // Source directory, dirfd() is the base for every entry
+    int dst_fd;            // Destination directory
+    struct stat st;        // Source mode and times, applied when the last entry is done
+    char *path;            // Source path, only used in error messages
+    int refs;              // The scan itself plus every queued entry
+} DirNode;
+
+typedef struct {
+    DirNode *parent;       // NULL for a top-level source, names are then whole paths
+    char *name;            // Entry name in the source directory
+    char *dst_name;        // Name to create in the destination directory
+    unsigned char type;    // d_type from the scan, DT_UNKNOWN when not known
+} CopyTask;
+
+typedef struct {
+    CopyTask *tasks;       // Used as a stack, depth first keeps few directories open
+    size_t count;
+    size_t capacity;
+    int pending;           // Queued plus running tasks, 0 means the copy is over
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    const CopyOptions *opts;   // Passed to copy_data() for every file, update mode is handled here too
+    CopyTreeStats *stats;
+    int failed;            // errno of an allocation failure, queued tasks are then dropped
+} CopyPool;
+
+static void report_error(CopyPool *pool, const DirNode *parent, const char *name, const char *what) {
+    int err = errno;
+    if (parent != NULL) {
+        fprintf(stderr, "mycp: %s/%s: %s: %s\n", parent->path, name, what, strerror(err));
+    } else {
+        fprintf(stderr, "mycp: %s: %s: %s\n", name, what, strerror(err));
+    }
+    __atomic_add_fetch(&pool->stats->errors, 1, __ATOMIC_RELAXED);
+}
+
+/* Stop the whole copy: it runs on worker threads, so an allocation failure is recorded
+ * here instead of exiting, and every worker drops what is still queued
+ */
+static void fail_pool(CopyPool *pool, int err) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->failed == 0) {
+        pool->failed = err;
+    }
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Queue an entry, returns 0, or -1 once the copy is stopped (by this call or an earlier one) */
+static int push_task(CopyPool *pool, DirNode *parent, const char *name, unsigned char type) {
+    char *copy = strdup(name);
+    pthread_mutex_lock(&pool->lock);
+    if (copy == NULL || pool->failed != 0) {
+        pthread_mutex_unlock(&pool->lock);
+        free(copy);
+        if (copy == NULL) {
+            fail_pool(pool, ENOMEM);
+        }
+        return -1;
+    }
+    if (pool->count == pool->capacity) {
+        size_t new_capacity = pool->capacity ? pool->capacity * 2 : INITIAL_CAPACITY;
+        CopyTask *tasks = realloc(pool->tasks, new_capacity * sizeof(CopyTask));
+        if (tasks == NULL) {
+            pthread_mutex_unlock(&pool->lock);
+            free(copy);
+            fail_pool(pool, ENOMEM);
+            return -1;
+        }
+        pool->tasks = tasks;
+        pool->capacity = new_capacity;
+    }
+    CopyTask *task = &pool->tasks[pool->count++];
+    task->parent = parent;
+    task->name = copy;
+    task->dst_name = task->name;
+    task->type = type;
+    pool->pending++;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+/* Drop one reference, the last one gives the directory its final mode and times */
+static void release_dir(CopyPool *pool, DirNode *node) {
+    while (node != NULL && __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        struct timespec times[2] = {node->st.st_atim, node->st.st_mtim};
+        // Written last: new entries would update the mtime, and a read-only mode would block them
+        if (fchmod(node->dst_fd, node->st.st_mode & 07777) == -1 || futimens(node->dst_fd, times) == -1) {
+            report_error(pool, NULL, node->path, "set attributes");
+        }
+        close(node->dst_fd);
+        closedir(node->src);
+
+        DirNode *parent = node->parent;
+        free(node->path);
+        free(node);
+        node = parent;
+    }
+}
+
+static void copy_regular(CopyPool *pool, int src_fd, int dst_fd, const CopyTask *task) {
+    int in = openat(src_fd, task->name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (in == -1) {
+        report_error(pool, task->parent, task->name, "open");
+        return;
+    }
+    struct stat st;
+    if (fstat(in, &st) == -1) {
+        report_error(pool, task->parent, task->name, "stat");
+        close(in);
+        return;
+    }
+    // Update mode: same size and mtime is current, a delta update patches the file in place
+    int update = pool->opts->update;
+    struct stat dst_st;
+    if (update != COPY_UPDATE_NONE && fstatat(dst_fd, task->dst_name, &dst_st, AT_SYMLINK_NOFOLLOW) == 0 &&
+        S_ISREG(dst_st.st_mode) && copy_unchanged(&st, &dst_st)) {
+        __atomic_add_fetch(&pool->stats->unchanged, 1, __ATOMIC_RELAXED);
+        close(in);
+        return;
+    }
+    int flags = update == COPY_UPDATE_DELTA ? O_RDWR : O_WRONLY | O_TRUNC;
+    int out = openat(dst_fd, task->dst_name, flags | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (out == -1) {
+        report_error(pool, task->parent, task->name, "create");
+        close(in);
+        return;
+    }
+
+    CopyResult result;
+    struct timespec times[2] = {st.st_atim, st.st_mtim};
+    if (copy_data(in, out, pool->opts, &result) == -1) {
+        report_error(pool, task->parent, task->name, "copy");
+    } else if (fchmod(out, st.st_mode & 07777) == -1 || futimens(out, times) == -1) {
+        report_error(pool, task->parent, task->name, "set attributes");
+    } else {
+        __atomic_add_fetch(&pool->stats->files, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&pool->stats->bytes, result.bytes, __ATOMIC_RELAXED);
+    }
+    close(in);
+    if (close(out) == -1) {
+        report_error(pool, task->parent, task->name, "close");
+    }
+}
+
+static void copy_symlink(CopyPool *pool, int src_fd, int dst_fd, const CopyTask *task) {
+    char target[PATH_MAX];
+    ssize_t len = readlinkat(src_fd, task->name, target, sizeof(target) - 1);
+    if (len == -1) {
+        report_error(pool, task->parent, task->name, "readlink");
+        return;
+    }
+    target[len] = '\0';
+    int rc = symlinkat(target, dst_fd, task->dst_name);
+    if (rc == -1 && errno == EEXIST && pool->opts->update != COPY_UPDATE_NONE) {
+        // Update mode keeps a link that already points the same way and replaces any other
+        char current[PATH_MAX];
+        ssize_t current_len = readlinkat(dst_fd, task->dst_name, current, sizeof(current) - 1);
+        if (current_len == len && memcmp(current, target, len) == 0) {
+            __atomic_add_fetch(&pool->stats->unchanged, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        if (unlinkat(dst_fd, task->dst_name, 0) == 0) {
+            rc = symlinkat(target, dst_fd, task->dst_name);
+        }
+    }
+    if (rc == -1) {
+        report_error(pool, task->parent, task->name, "symlink");
+        return;
+    }
+
+    struct stat st;
+    if (fstatat(src_fd, task->name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+        struct timespec times[2] = {st.st_atim, st.st_mtim};
+        utimensat(dst_fd, task->dst_name, times, AT_SYMLINK_NOFOLLOW);
+    }
+    __atomic_add_fetch(&pool->stats->files, 1, __ATOMIC_RELAXED);
+}
+
+/* FIFOs, sockets and device nodes are recreated rather than read */
+static void copy_special(CopyPool *pool, int dst_fd, const CopyTask *task, const struct stat *st) {
+    struct timespec times[2] = {st->st_atim, st->st_mtim};
+    if (mknodat(dst_fd, task->dst_name, st->st_mode, st->st_rdev) == -1) {
+        if (errno == EEXIST && pool->opts->update != COPY_UPDATE_NONE) {
+            __atomic_add_fetch(&pool->stats->unchanged, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        report_error(pool, task->parent, task->name, "mknod");
+        return;
+    }
+    utimensat(dst_fd, task->dst_name, times, AT_SYMLINK_NOFOLLOW);
+    __atomic_add_fetch(&pool->stats->files, 1, __ATOMIC_RELAXED);
+}
+
+/* Create the destination directory, then queue every entry of the source one */
+static void copy_directory(CopyPool *pool, int src_fd, int dst_fd, const CopyTask *task) {
+    int fd = openat(src_fd, task->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1) {
+        report_error(pool, task->parent, task->name, "open directory");
+        return;
+    }
+    DirNode *node = calloc(1, sizeof(DirNode));
+    if (node == NULL || fstat(fd, &node->st) == -1 || (node->src = fdopendir(fd)) == NULL) {
+        report_error(pool, task->parent, task->name, "open directory");
+        free(node);
+        close(fd);
+        return;
+    }
+
+    // Owner-writable until the last entry is in, the real mode is set by release_dir
+    if (mkdirat(dst_fd, task->dst_name, S_IRWXU) == -1 && errno != EEXIST) {
+        report_error(pool, task->parent, task->name, "mkdir");
+        closedir(node->src);
+        free(node);
+        return;
+    }
+    node->dst_fd = openat(dst_fd, task->dst_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (node->dst_fd == -1) {
+        report_error(pool, task->parent, task->name, "open destination directory");
+        closedir(node->src);
+        free(node);
+        return;
+    }
+
+    if (task->parent != NULL) {
+        node->path = malloc(strlen(task->parent->path) + strlen(task->name) + 2);
+        if (node->path != NULL) {
+            sprintf(node->path, "%s/%s", task->parent->path, task->name);
+        }
+    } else {
+        node->path = strdup(task->name);
+    }
+    if (node->path == NULL) {
+        fail_pool(pool, ENOMEM);
+        close(node->dst_fd);
+        closedir(node->src);
+        free(node);
+        return;
+    }
+    node->parent = task->parent;
+    node->refs = 1;
+    if (node->parent != NULL) {
+        __atomic_add_fetch(&node->parent->refs, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch(&pool->stats->directories, 1, __ATOMIC_RELAXED);
+
+    struct dirent *entry;
+    errno = 0;
+    while ((entry = readdir(node->src)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        __atomic_add_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+        if (push_task(pool, node, entry->d_name, entry->d_type) == -1) {
+            __atomic_sub_fetch(&node->refs, 1, __ATOMIC_RELAXED);   // Still held by the scan, never 0 here
+            errno = 0;
+            break;
+        }
+    }
+    if (errno != 0) {
+        report_error(pool, task->parent, task->name, "read directory");
+    }
+    release_dir(pool, node);
+}
+
+static void run_task(CopyPool *pool, CopyTask *task) {
+    int src_fd = task->parent != NULL ? dirfd(task->parent->src) : AT_FDCWD;
+    int dst_fd = task->parent != NULL ? task->parent->dst_fd : AT_FDCWD;
+    unsigned char type = task->type;
+    struct stat st;
+
+    if (type == DT_UNKNOWN || (type != DT_DIR && type != DT_REG && type != DT_LNK)) {
+        // The file system did not give the type, or it is special and needs the rest of stat
+        if (fstatat(src_fd, task->name, &st, AT_SYMLINK_NOFOLLOW) == -1) {
+            report_error(pool, task->parent, task->name, "stat");
+            return;
+        }
+        type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : S_ISLNK(st.st_mode) ? DT_LNK : DT_UNKNOWN;
+    }
+
+    if (type == DT_DIR) {
+        copy_directory(pool, src_fd, dst_fd, task);
+    } else if (type == DT_REG) {
+        copy_regular(pool, src_fd, dst_fd, task);
+    } else if (type == DT_LNK) {
+        copy_symlink(pool, src_fd, dst_fd, task);
+    } else {
+        copy_special(pool, dst_fd, task, &st);
+    }
+}
+
+static void *copy_worker(void *arg) {
+    CopyPool *pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (pool->count == 0 && pool->pending > 0) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        if (pool->count == 0) {
+            break;  // Nothing queued and nothing running, the tree is done
+        }
+        CopyTask task = pool->tasks[--pool->count];
+        int failed = pool->failed;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (!failed) {
+            run_task(pool, &task);
+        }
+        if (task.parent != NULL) {
+            release_dir(pool, task.parent);
+        }
+        free(task.name);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_broadcast(&pool->cond);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Copy 'source' (a directory or any other file) like cp -R: into destination/basename
+ * when 'destination' is an existing directory, to 'destination' itself otherwise.
+ * Modes and times are kept, symlinks are copied as links. A failing entry is reported
+ * on stderr and the rest of the tree is still copied. 'opts' (NULL for defaults) is
+ * used for every file; with opts->update, entries that are already current are
+ * counted in stats->unchanged and left alone. An allocation failure stops the whole
+ * copy and leaves its errno in stats->failed.
+ * Returns 0, or -1 if anything failed; counts are added to 'stats'.
+ */
+int copy_tree(const char *source, const char *destination, const CopyOptions *opts, CopyTreeStats *stats) {
+    CopyOptions defaults;
+    struct stat st;
+    char *target;
+    long errors_before = stats->errors;
+
+    if (stat(destination, &st) == 0 && S_ISDIR(st.st_mode)) {
+        char *copy = strdup(source);
+        target = malloc(strlen(destination) + strlen(source) + 2);
+        if (copy == NULL || target == NULL) {
+            free(target);
+            target = NULL;
+        } else {
+            sprintf(target, "%s/%s", destination, basename(copy));
+        }
+        free(copy);
+    } else {
+        target = strdup(destination);
+    }
+    if (target == NULL) {
+        stats->failed = ENOMEM;
+        return -1;
+    }
+
+    // Refuse to copy a directory into itself, it would never end
+    char real_source[PATH_MAX];
+    char real_parent[PATH_MAX];
+    char *parent_copy = strdup(target);
+    if (realpath(source, real_source) != NULL && parent_copy != NULL &&
+        realpath(dirname(parent_copy), real_parent) != NULL) {
+        size_t len = strlen(real_source);
+        if (strncmp(real_parent, real_source, len) == 0 && (real_parent[len] == '/' || real_parent[len] == '\0')) {
+            fprintf(stderr, "mycp: cannot copy '%s' into itself\n", source);
+            free(parent_copy);
+            free(target);
+            stats->errors++;
+            return -1;
+        }
+    }
+    free(parent_copy);
+
+    CopyPool pool;
+    memset(&pool, 0, sizeof(pool));
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond, NULL);
+    if (opts == NULL) {
+        copy_options_init(&defaults);
+        opts = &defaults;
+    }
+    pool.opts = opts;
+    pool.stats = stats;
+
+    // The top-level entry is a task like any other, with whole paths instead of names
+    if (push_task(&pool, NULL, source, DT_UNKNOWN) == -1) {
+        stats->failed = pool.failed;
+        pthread_mutex_destroy(&pool.lock);
+        pthread_cond_destroy(&pool.cond);
+        free(target);
+        return -1;
+    }
+    pool.tasks[0].dst_name = target;
+
+    int workers = get_nprocs();
+    if (workers < COPY_TREE_MIN_WORKERS) {
+        workers = COPY_TREE_MIN_WORKERS;
+    }
+    pthread_t threads[workers];
+    int started = 0;
+    for (int k = 0; k < workers; k++) {
+        if (pthread_create(&threads[k], NULL, copy_worker, &pool) != 0) {
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        copy_worker(&pool);  // No threads available, copy on this one
+    }
+    for (int k = 0; k < started; k++) {
+        pthread_join(threads[k], NULL);
+    }
+
+    TRACE(TRACE_INFO, "Copied tree %s to %s: %ld files, %ld directories, %lld bytes, %ld unchanged, %ld errors, %d workers",
+          source, target, stats->files, stats->directories, (long long)stats->bytes, stats->unchanged,
+          stats->errors - errors_before, started);
+
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.cond);
+    free(pool.tasks);
+    free(target);
+    if (pool.failed != 0) {
+        stats->failed = pool.failed;
+        return -1;
+    }
+    return stats->errors > errors_before ? -1 : 0;
+}
@@ -0,0 +1,25 @@
+/*
+Author: Assem Samy
+File: copytree.h
+Comment: mycp -r, copies a directory tree with a pool of threads working on directory descriptors
+*/
+
+#ifndef COPYTREE_H
+#define COPYTREE_H
+/*-----------------includes section--------------*/
+#include <sys/types.h>
+#include "copy.h"
+/*----------------macros declarations-----------------*/
+#define COPY_TREE_MIN_WORKERS 4   // Small copies wait on I/O, so use at least this many threads
+/*-----------------types declarations-----------------*/
+typedef struct {
+    long files;        // Regular files and symlinks copied
+    long directories;
+    off_t bytes;
+    long errors;       // Entries that failed, each one reported on stderr
+    long unchanged;    // Entries update mode found already current and left alone
+    int failed;        // errno of a failure that stopped the copy (out of memory), 0 if none
+} CopyTreeStats;
+/*-----------section contains functions declarations------------*/
+int copy_tree(const char *source, const char *destination, const CopyOptions *opts, CopyTreeStats *stats);
+#endif
@@ -0,0 +1,34 @@
+/*
+Author: Assem Samy
+File: dirents.h
+Comment: Raw getdents64 records, shared by the directory scans of myls and myrm -r
+*/
+
+#ifndef DIRENTS_H
+#define DIRENTS_H
+/*-----------------includes section--------------*/
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+/*-----------------types declarations-----------------*/
+/* Record layout returned by getdents64 */
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+/*-----------section contains functions declarations------------*/
+/* Fill 'buffer' with as many records as fit. Returns the bytes filled, 0 at the end
+ * of the directory, or -1 with errno set.
+ */
+static inline long dirents_read(int dir_fd, char *buffer, size_t size) {
+    return syscall(SYS_getdents64, dir_fd, buffer, size);
+}
+
+/* "." or "..", which the scans skip */
+static inline int dirents_is_dot(const char *name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+#endif
@@ -0,0 +1,280 @@
+/*
+Author: Assem Samy
+File: entrystore.c
+Comment: Growable directory entry store for myls, no limit on the number of entries or the length of names
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "entrystore.h"
+#include "trace.h"
+#include "dirents.h"
+#include <pthread.h>
+
+/*-----------------types and static functions---------------*/
+
+/* Shared by the threads of one entry_store_stat() call */
+typedef struct {
+    EntryStore *store;
+    int dir_fd;
+    unsigned int mask;
+    char time_field;
+    size_t next;                // First entry no thread has claimed yet
+} StatJob;
+
+/* Grow '*buffer' to hold at least 'needed' elements. Returns 0, or -1 with errno set,
+ * the buffer and its capacity are then left as they were.
+ */
+static int grow(void **buffer, size_t *capacity, size_t needed, size_t element_size, size_t initial) {
+    size_t new_capacity = *capacity ? *capacity : initial;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    void *grown = realloc(*buffer, new_capacity * element_size);
+    if (grown == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    *buffer = grown;
+    *capacity = new_capacity;
+    return 0;
+}
+
+static int compare_name(const void *a, const void *b, void *arg) {
+    const EntryStore *store = arg;
+    return strcmp(entry_name(store, a), entry_name(store, b));
+}
+
+// Newest first
+static int compare_time(const void *a, const void *b, void *arg) {
+    const DirEntry *entryA = a;
+    const DirEntry *entryB = b;
+    (void)arg;
+
+    if (entryA->time < entryB->time) return 1;
+    if (entryA->time > entryB->time) return -1;
+    return 0;
+}
+
+static void stat_entry(StatJob *job, size_t index) {
+    EntryStore *store = job->store;
+    DirEntry *entry = &store->entries[index];
+    struct statx stx;
+
+    // Relative to the directory fd: no path to build, no lookup of the directory per entry
+    if (statx(job->dir_fd, entry_name(store, entry), AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, job->mask, &stx) == -1) {
+        fprintf(stderr, "statx failed: %s: %s\n", entry_name(store, entry), strerror(errno));
+        entry->failed = 1;
+        return;
+    }
+    switch (job->time_field) {
+        case 'c':
+            entry->time = stx.stx_ctime.tv_sec;
+            break;
+        case 'm':
+            entry->time = stx.stx_mtime.tv_sec;
+            break;
+        case 'a':
+            entry->time = stx.stx_atime.tv_sec;
+            break;
+    }
+    if (job->mask & STATX_INO) {
+        entry->ino = stx.stx_ino;
+    }
+    if (store->meta != NULL) {
+        EntryMeta *meta = &store->meta[index];
+        meta->mode = stx.stx_mode;
+        meta->nlink = stx.stx_nlink;
+        meta->uid = stx.stx_uid;
+        meta->gid = stx.stx_gid;
+        meta->size = stx.stx_size;
+        entry->meta = (unsigned int)index;
+    }
+}
+
+static void *stat_worker(void *arg) {
+    StatJob *job = arg;
+    size_t count = job->store->count;
+
+    for (;;) {
+        size_t start = __atomic_fetch_add(&job->next, ENTRY_STAT_CHUNK, __ATOMIC_RELAXED);
+        if (start >= count) {
+            break;
+        }
+        size_t end = (count - start > ENTRY_STAT_CHUNK) ? start + ENTRY_STAT_CHUNK : count;
+        for (size_t i = start; i < end; i++) {
+            stat_entry(job, i);
+        }
+    }
+    return NULL;
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+void entry_store_init(EntryStore *store) {
+    memset(store, 0, sizeof(*store));
+}
+
+/* Append an entry, copying its name into the name buffer.
+ * The returned record is valid until the next add; time starts at 0.
+ * Returns NULL with errno set if the store cannot grow, the entries so far are kept.
+ */
+DirEntry *entry_store_add(EntryStore *store, const char *name, size_t name_len, unsigned char type, ino_t ino) {
+    if (store->count == store->capacity &&
+        grow((void **)&store->entries, &store->capacity, store->count + 1, sizeof(DirEntry),
+             ENTRY_STORE_INITIAL_ENTRIES) == -1) {
+        return NULL;
+    }
+    if (store->names_capacity - store->names_used < name_len + 1 &&
+        grow((void **)&store->names, &store->names_capacity, store->names_used + name_len + 1, 1,
+             ENTRY_STORE_INITIAL_NAMES) == -1) {
+        return NULL;
+    }
+
+    DirEntry *entry = &store->entries[store->count++];
+    entry->name = (unsigned int)store->names_used;
+    entry->name_len = (unsigned short)name_len;
+    entry->type = type;
+    entry->meta = 0;
+    entry->failed = 0;
+    entry->ino = ino;
+    entry->time = 0;
+    memcpy(store->names + store->names_used, name, name_len);
+    store->names[store->names_used + name_len] = '\0';
+    store->names_used += name_len + 1;
+    return entry;
+}
+
+/* Add every entry of the directory open on 'dir_fd', "." and ".." only with
+ * ENTRY_LOAD_DOTS. The names, d_type and d_ino come straight from getdents64 into a
+ * large buffer, so a listing of names or inode numbers costs no stat at all.
+ * Returns 0, or -1 with errno set if the directory cannot be read or the store cannot
+ * grow (ENOMEM). The store keeps what was added, entry_store_free() it either way.
+ */
+int entry_store_scan(EntryStore *store, int dir_fd, int flags) {
+    char *buffer = malloc(ENTRY_STORE_DENTS_SIZE);
+    long n;
+
+    if (buffer == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    while ((n = dirents_read(dir_fd, buffer, ENTRY_STORE_DENTS_SIZE)) > 0) {
+        for (long offset = 0; offset < n;) {
+            struct linux_dirent64 *entry = (struct linux_dirent64 *)(buffer + offset);
+            offset += entry->d_reclen;
+            const char *name = entry->d_name;
+            if (!(flags & ENTRY_LOAD_DOTS) && dirents_is_dot(name)) {
+                continue;
+            }
+            if (entry_store_add(store, name, strlen(name), entry->d_type, entry->d_ino) == NULL) {
+                free(buffer);
+                errno = ENOMEM;
+                return -1;
+            }
+        }
+    }
+    int err = errno;
+    free(buffer);
+    errno = err;
+    return n == 0 ? 0 : -1;
+}
+
+/* entry_store_scan() on a directory given by path */
+int entry_store_load(EntryStore *store, const char *dir, int flags) {
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    int rc = entry_store_scan(store, fd, flags);
+    int err = errno;
+    close(fd);
+    errno = err;
+    return rc;
+}
+
+/* The metadata stage of myls: one statx per entry relative to 'dir_fd', asking only
+ * for the STATX_* fields in 'mask' plus the time 'time_field' names ('c', 'm' or 'a',
+ * anything else for none), which goes to entry->time. A mask with more than times and
+ * STATX_INO also fills EntryMeta for each entry. The calls are independent, and on NFS
+ * or FUSE each one is a round trip, so a large directory is spread over a pool of
+ * threads that keeps several in flight. glibc emulates statx with fstatat on kernels
+ * without it. Entries that cannot be stat'ed are reported and dropped.
+ * Returns the number of entries dropped, or -1 with errno set (and nothing stat'ed)
+ * if there is no memory for the EntryMeta array.
+ */
+int entry_store_stat(EntryStore *store, int dir_fd, unsigned int mask, char time_field) {
+    StatJob job = { store, dir_fd, mask, time_field, 0 };
+    size_t count = store->count;
+
+    if (time_field == 'c') {
+        job.mask |= STATX_CTIME;
+    } else if (time_field == 'm') {
+        job.mask |= STATX_MTIME;
+    } else if (time_field == 'a') {
+        job.mask |= STATX_ATIME;
+    }
+    if (mask & (STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID | STATX_SIZE)) {
+        free(store->meta);
+        store->meta = malloc((count ? count : 1) * sizeof(EntryMeta));
+        if (store->meta == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    int threads = 1;
+    if (count >= ENTRY_STAT_PARALLEL_MIN) {
+        threads = get_nprocs();
+        if (threads < ENTRY_STAT_MIN_THREADS) {
+            threads = ENTRY_STAT_MIN_THREADS;
+        }
+        if (threads > ENTRY_STAT_MAX_THREADS) {
+            threads = ENTRY_STAT_MAX_THREADS;
+        }
+    }
+    pthread_t workers[ENTRY_STAT_MAX_THREADS];
+    int started = 0;
+    while (started < threads - 1 && pthread_create(&workers[started], NULL, stat_worker, &job) == 0) {
+        started++;
+    }
+    stat_worker(&job);   // The calling thread takes its share too
+    for (int k = 0; k < started; k++) {
+        pthread_join(workers[k], NULL);
+    }
+    TRACE(TRACE_INFO, "statx of %zu entries, mask 0x%x, %d threads", count, job.mask, started + 1);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!store->entries[i].failed) {
+            store->entries[kept++] = store->entries[i];
+        }
+    }
+    store->count = kept;
+    return (int)(count - kept);
+}
+
+void entry_store_sort_by_name(EntryStore *store) {
+    qsort_r(store->entries, store->count, sizeof(DirEntry), compare_name, store);
+}
+
+void entry_store_sort_by_time(EntryStore *store) {
+    qsort_r(store->entries, store->count, sizeof(DirEntry), compare_time, store);
+}
+
+int entry_store_max_name_len(const EntryStore *store) {
+    int width = 0;
+    for (size_t i = 0; i < store->count; i++) {
+        if (store->entries[i].name_len > width) {
+            width = store->entries[i].name_len;
+        }
+    }
+    return width;
+}
+
+void entry_store_free(EntryStore *store) {
+    free(store->entries);
+    free(store->names);
+    free(store->meta);
+    entry_store_init(store);
+}
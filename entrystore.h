@@ -0,0 +1,70 @@
+/*
+Author: Assem Samy
+File: entrystore.h
+Comment: Growable directory entry store for myls, compact records that point into one packed name buffer
+*/
+
+#ifndef ENTRYSTORE_H
+#define ENTRYSTORE_H
+/*-----------------includes section--------------*/
+#include <sys/types.h>
+#include <time.h>
+/*----------------macros declarations-----------------*/
+#define ENTRY_STORE_INITIAL_ENTRIES 256
+#define ENTRY_STORE_INITIAL_NAMES   (16 * 1024)   // Bytes, doubled as names come in
+#define ENTRY_STORE_DENTS_SIZE      (256 * 1024)  // getdents64 buffer, several thousand names per call
+#define ENTRY_LOAD_DOTS             1             // Keep "." and ".."
+#define ENTRY_STAT_PARALLEL_MIN     2048          // Entries before the metadata stage uses threads
+#define ENTRY_STAT_MIN_THREADS      4             // statx waits on the disk or the server, so use at least this many
+#define ENTRY_STAT_MAX_THREADS      16
+#define ENTRY_STAT_CHUNK            256           // Entries a thread claims at a time
+/*-----------------types declarations-----------------*/
+/* One directory entry, 32 bytes whatever the length of its name */
+typedef struct {
+    unsigned int name;          // Offset of the NUL terminated name in EntryStore.names
+    unsigned int meta;          // Index in EntryStore.meta once entry_store_stat() filled it
+    unsigned short name_len;    // Without the NUL, NAME_MAX fits
+    unsigned char type;         // d_type from the directory (DT_UNKNOWN if it was not given)
+    unsigned char failed;       // entry_store_stat() could not stat it
+    ino_t ino;                  // d_ino, no stat needed
+    time_t time;                // Sort key: ctime, mtime or atime
+} DirEntry;
+
+/* What a long listing shows besides the name, the time and the inode number */
+typedef struct {
+    mode_t mode;
+    unsigned int nlink;
+    uid_t uid;
+    gid_t gid;
+    off_t size;
+} EntryMeta;
+
+typedef struct {
+    DirEntry *entries;
+    size_t count;
+    size_t capacity;
+    char *names;                // Every name back to back, records refer to them by offset
+    size_t names_used;
+    size_t names_capacity;
+    EntryMeta *meta;            // NULL unless entry_store_stat() was asked for more than a time
+} EntryStore;
+/*-----------section contains functions declarations------------*/
+void entry_store_init(EntryStore *store);
+DirEntry *entry_store_add(EntryStore *store, const char *name, size_t name_len, unsigned char type, ino_t ino);
+int entry_store_scan(EntryStore *store, int dir_fd, int flags);
+int entry_store_load(EntryStore *store, const char *dir, int flags);
+int entry_store_stat(EntryStore *store, int dir_fd, unsigned int mask, char time_field);
+void entry_store_sort_by_name(EntryStore *store);
+void entry_store_sort_by_time(EntryStore *store);
+int entry_store_max_name_len(const EntryStore *store);
+void entry_store_free(EntryStore *store);
+
+/* Name of an entry, valid until the next entry_store_add() (the buffer may move) */
+static inline const char *entry_name(const EntryStore *store, const DirEntry *entry) {
+    return store->names + entry->name;
+}
+
+static inline const EntryMeta *entry_meta(const EntryStore *store, const DirEntry *entry) {
+    return &store->meta[entry->meta];
+}
+#endif
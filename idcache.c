@@ -0,0 +1,168 @@
+/*
+Author: Assem Samy
+File: idcache.c
+Comment: Looks owner and group names up through NSS once per id and remembers them for the whole session
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "idcache.h"
+
+/*-----------------variables and static functions---------------*/
+typedef struct IdEntry {
+    struct IdEntry *next;
+    unsigned int id;
+    char *name;            // NULL when NSS does not know the id, that answer is cached too
+    time_t loaded;         // When NSS was asked, for the TTL
+} IdEntry;
+
+/* One table for users and one for groups, each follows its own file */
+typedef struct {
+    IdEntry *buckets[ID_CACHE_BUCKETS];
+    const char *file;          // The file whose change empties the table
+    struct stat file_state;    // Its inode, size and mtime when last checked
+    time_t last_check;
+    unsigned long hits;
+    unsigned long misses;      // Lookups that went to NSS, expired entries included
+    unsigned long flushes;     // Times the file changed under the table
+    unsigned long entries;
+} IdTable;
+
+static IdTable users = { .file = ID_CACHE_PASSWD_FILE };
+static IdTable groups = { .file = ID_CACHE_GROUP_FILE };
+static long ttl = 0;           // Seconds an answer is trusted, 0 until the file changes
+
+static unsigned int id_hash(unsigned int id) {
+    return (id * 2654435761u) & (ID_CACHE_BUCKETS - 1);
+}
+
+static void drop_entries(IdTable *table) {
+    for (int b = 0; b < ID_CACHE_BUCKETS; b++) {
+        IdEntry *entry = table->buckets[b];
+        while (entry != NULL) {
+            IdEntry *next = entry->next;
+            free(entry->name);
+            free(entry);
+            entry = next;
+        }
+        table->buckets[b] = NULL;
+    }
+    table->entries = 0;
+}
+
+/* Empty the table when its file was replaced or edited. Only local accounts can be
+ * seen this way, names served by LDAP or NIS change without it: the TTL covers those.
+ * Checked at most once per ID_CACHE_CHECK_INTERVAL.
+ */
+static void sync_with_file(IdTable *table, time_t now) {
+    struct stat info;
+
+    if (now - table->last_check < ID_CACHE_CHECK_INTERVAL) {
+        return;
+    }
+    table->last_check = now;
+    if (stat(table->file, &info) == -1) {
+        memset(&info, 0, sizeof(info));
+    }
+    if (info.st_ino != table->file_state.st_ino || info.st_size != table->file_state.st_size ||
+        info.st_mtim.tv_sec != table->file_state.st_mtim.tv_sec ||
+        info.st_mtim.tv_nsec != table->file_state.st_mtim.tv_nsec) {
+        if (table->entries > 0) {
+            table->flushes++;
+        }
+        drop_entries(table);
+        table->file_state = info;
+    }
+}
+
+/* The cached entry for 'id', asking NSS through 'fetch' on a miss or once it expired */
+static const char *lookup(IdTable *table, unsigned int id, char *(*fetch)(unsigned int)) {
+    time_t now = time(NULL);
+    sync_with_file(table, now);
+
+    unsigned int b = id_hash(id);
+    IdEntry *entry;
+    for (entry = table->buckets[b]; entry != NULL; entry = entry->next) {
+        if (entry->id == id) {
+            break;
+        }
+    }
+    if (entry != NULL && (ttl == 0 || now - entry->loaded < ttl)) {
+        table->hits++;
+        return entry->name;
+    }
+
+    table->misses++;
+    if (entry == NULL) {
+        entry = calloc(1, sizeof(IdEntry));
+        if (entry == NULL) {
+            perror("malloc failed");
+            return NULL;
+        }
+        entry->id = id;
+        entry->next = table->buckets[b];
+        table->buckets[b] = entry;
+        table->entries++;
+    }
+    free(entry->name);
+    entry->name = fetch(id);
+    entry->loaded = now;
+    return entry->name;
+}
+
+static char *fetch_user(unsigned int id) {
+    struct passwd *pwd = getpwuid((uid_t)id);
+    return pwd ? strdup(pwd->pw_name) : NULL;
+}
+
+static char *fetch_group(unsigned int id) {
+    struct group *grp = getgrgid((gid_t)id);
+    return grp ? strdup(grp->gr_name) : NULL;
+}
+
+static void print_table(const char *label, const IdTable *table) {
+    unsigned long lookups = table->hits + table->misses;
+    printf("%-6s  %7lu  %7lu  %7lu  %7lu  %5.1f%%\n", label, table->entries, table->hits, table->misses,
+           table->flushes, lookups ? 100.0 * table->hits / lookups : 0.0);
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Name of the user 'uid', or NULL if there is none. A directory of files owned by a
+ * handful of users costs a handful of NSS lookups (each maybe a file scan or an LDAP
+ * round trip) instead of one per file, for every myls of the session.
+ * The returned string is owned by the cache, valid until the next user lookup.
+ */
+const char *id_cache_user(uid_t uid) {
+    return lookup(&users, (unsigned int)uid, fetch_user);
+}
+
+/* Name of the group 'gid', or NULL, like id_cache_user() */
+const char *id_cache_group(gid_t gid) {
+    return lookup(&groups, (unsigned int)gid, fetch_group);
+}
+
+/* Ask NSS again for names older than 'seconds', 0 keeps them until the file changes */
+void id_cache_set_ttl(long seconds) {
+    ttl = seconds;
+}
+
+/* Print both tables' size and hit/miss counters */
+void id_cache_print(void) {
+    printf("table   entries     hits   misses  flushes  hit rate\n");
+    print_table("users", &users);
+    print_table("groups", &groups);
+    if (ttl > 0) {
+        printf("ttl: %ld s\n", ttl);
+    } else {
+        printf("ttl: none, refreshed when %s or %s changes\n", users.file, groups.file);
+    }
+}
+
+/* Forget every cached name and zero the counters */
+void id_cache_reset(void) {
+    drop_entries(&users);
+    drop_entries(&groups);
+    users.hits = users.misses = users.flushes = 0;
+    groups.hits = groups.misses = groups.flushes = 0;
+}
@@ -0,0 +1,22 @@
+/*
+Author: Assem Samy
+File: idcache.h
+Comment: Cache of uid -> user name and gid -> group name lookups for long listings (shown and reset by myidcache)
+*/
+
+#ifndef IDCACHE_H
+#define IDCACHE_H
+/*-----------------includes section--------------*/
+#include <sys/types.h>
+/*----------------macros declarations-----------------*/
+#define ID_CACHE_BUCKETS        64          // Power of two, per table
+#define ID_CACHE_CHECK_INTERVAL 1           // Seconds between /etc/passwd and /etc/group checks
+#define ID_CACHE_PASSWD_FILE    "/etc/passwd"
+#define ID_CACHE_GROUP_FILE     "/etc/group"
+/*-----------section contains functions declarations------------*/
+const char *id_cache_user(uid_t uid);
+const char *id_cache_group(gid_t gid);
+void id_cache_set_ttl(long seconds);
+void id_cache_print(void);
+void id_cache_reset(void);
+#endif
@@ -0,0 +1,465 @@
+/*
+Author: Assem Samy
+File: jobs.c
+Comment: Background jobs, children are reaped from an epoll loop over their pidfds plus a SIGCHLD signalfd
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "jobs.h"
+#include "trace.h"
+#include <signal.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+
+/*-----------------variables and static functions---------------*/
+static Job *job_list = NULL;        // Oldest first, the last job is the current one (%+)
+static int epoll_fd = -1;
+static int sigchld_fd = -1;
+static int job_control = 0;         // Process groups and terminal hand-off, interactive only
+static pid_t shell_pgid = 0;
+static int input_fd = -1;           // Descriptor last seen by jobs_wait_input
+static int input_pollable = 0;      // 0 when epoll refused input_fd (a regular file)
+static char sigchld_marker;         // epoll data for the signalfd
+static char input_marker;           // epoll data for the input descriptor
+static int input_ready = 0;
+
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static void update_job_state(Job *job) {
+    for (int k = 0; k < job->proc_count; k++) {
+        if (!job->procs[k].done) {
+            return;
+        }
+    }
+    job->state = JOB_DONE;
+}
+
+static void mark_done(JobProcess *proc, int status) {
+    proc->status = status;
+    proc->done = 1;
+    clock_gettime(CLOCK_MONOTONIC, &proc->finished);
+    if (proc->pidfd != -1) {
+        close(proc->pidfd);  // Closing also drops it from the epoll set
+        proc->pidfd = -1;
+    }
+    update_job_state(proc->job);
+}
+
+/* Collect whatever happened to one process without blocking */
+static void reap_process(JobProcess *proc, int flags) {
+    int wstatus;
+    struct rusage usage;
+    pid_t r;
+
+    // wait4 rather than waitpid so mytime gets the child's resource usage for free
+    do {
+        r = wait4(proc->pid, &wstatus, WNOHANG | flags, &usage);
+    } while (r == -1 && errno == EINTR);
+
+    if (r == 0) {
+        return;
+    }
+    if (r == -1) {
+        mark_done(proc, 0);  // Already reaped elsewhere, nothing more will come
+        return;
+    }
+    if (WIFSTOPPED(wstatus)) {
+        proc->job->state = JOB_STOPPED;
+        return;
+    }
+    if (WIFCONTINUED(wstatus)) {
+        proc->job->state = JOB_RUNNING;
+        return;
+    }
+    int status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);
+    proc->usage = usage;
+    TRACE(TRACE_DEBUG, "reaped pid %d of job %d, status %d", (int)proc->pid, proc->job->id, status);
+    mark_done(proc, status);
+}
+
+/* SIGCHLD also reports stops and continues, which pidfds do not, so look at every live process */
+static void handle_sigchld(void) {
+    struct signalfd_siginfo info;
+    while (read(sigchld_fd, &info, sizeof(info)) == sizeof(info)) {
+        // Drain, signals are coalesced anyway
+    }
+    for (Job *job = job_list; job != NULL; job = job->next) {
+        for (int k = 0; k < job->proc_count; k++) {
+            if (!job->procs[k].done) {
+                reap_process(&job->procs[k], WUNTRACED | WCONTINUED);
+            }
+        }
+    }
+}
+
+static void remove_job(Job *job) {
+    Job **link = &job_list;
+    while (*link != NULL && *link != job) {
+        link = &(*link)->next;
+    }
+    if (*link != NULL) {
+        *link = job->next;
+    }
+    for (int k = 0; k < job->proc_count; k++) {
+        if (job->procs[k].pidfd != -1) {
+            close(job->procs[k].pidfd);
+        }
+    }
+    free(job->procs);
+    free(job->command);
+    free(job);
+}
+
+/* Pipefail status of a finished job: the last failing stage, 0 if all succeeded */
+static int job_status(const Job *job) {
+    int result = 0;
+    for (int k = 0; k < job->proc_count; k++) {
+        if (job->procs[k].status != 0) {
+            result = job->procs[k].status;
+        }
+    }
+    return result;
+}
+
+static void signal_job(Job *job, int sig) {
+    if (job->pgid > 0) {
+        kill(-job->pgid, sig);
+        return;
+    }
+    for (int k = 0; k < job->proc_count; k++) {
+        if (!job->procs[k].done) {
+            kill(job->procs[k].pid, sig);
+        }
+    }
+}
+
+static const char *state_name(const Job *job) {
+    if (job->state == JOB_RUNNING) {
+        return "Running";
+    }
+    if (job->state == JOB_STOPPED) {
+        return "Stopped";
+    }
+    return job_status(job) == 0 ? "Done" : "Exit";
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Set up the event loop. SIGCHLD is blocked and read from a signalfd instead.
+ * Job control (process groups, terminal hand-off, ignoring ^Z/^C in the shell) is only
+ * turned on for an interactive shell that owns its terminal.
+ */
+void jobs_init(int interactive) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        perror("epoll_create1");
+        exit(EXIT_FAILURE);
+    }
+    sigchld_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sigchld_fd == -1) {
+        perror("signalfd");
+        exit(EXIT_FAILURE);
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &sigchld_marker;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sigchld_fd, &ev);
+
+    if (interactive && isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp()) {
+        job_control = 1;
+        shell_pgid = getpgrp();
+        signal(SIGINT, SIG_IGN);
+        signal(SIGQUIT, SIG_IGN);
+        signal(SIGTSTP, SIG_IGN);
+        signal(SIGTTIN, SIG_IGN);
+        signal(SIGTTOU, SIG_IGN);
+    }
+}
+
+int jobs_control_enabled(void) {
+    return job_control;
+}
+
+/* Add a job with room for 'proc_count' processes, filled in by job_set_process */
+Job *job_create(const char *command, int proc_count, int background) {
+    Job *job = calloc(1, sizeof(Job));
+    if (job == NULL) {
+        perror("malloc failed");
+        return NULL;
+    }
+    job->procs = calloc(proc_count, sizeof(JobProcess));
+    job->command = strdup(command);
+    if (job->procs == NULL || job->command == NULL) {
+        perror("malloc failed");
+        free(job->procs);
+        free(job->command);
+        free(job);
+        return NULL;
+    }
+    job->proc_count = proc_count;
+    job->background = background;
+    job->state = JOB_RUNNING;
+
+    int id = 0;
+    Job **link = &job_list;
+    while (*link != NULL) {
+        if ((*link)->id > id) {
+            id = (*link)->id;
+        }
+        link = &(*link)->next;
+    }
+    job->id = id + 1;
+    *link = job;
+
+    for (int k = 0; k < proc_count; k++) {
+        job->procs[k].job = job;
+        job->procs[k].pid = -1;
+        job->procs[k].pidfd = -1;
+    }
+    return job;
+}
+
+/* Record the process started for stage 'index'. A pid of -1 means it never started and
+ * 'status' is its final status. Started processes get a pidfd watched by the event loop.
+ */
+void job_set_process(Job *job, int index, pid_t pid, int status) {
+    JobProcess *proc = &job->procs[index];
+
+    proc->pid = pid;
+    clock_gettime(CLOCK_MONOTONIC, &proc->started);
+    if (pid == -1) {
+        mark_done(proc, status);
+        return;
+    }
+
+    proc->pidfd = open_pidfd(pid);
+    if (proc->pidfd != -1) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = proc;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, proc->pidfd, &ev) == -1) {
+            close(proc->pidfd);
+            proc->pidfd = -1;  // SIGCHLD still covers it
+        }
+    }
+}
+
+/* Called once every stage has been started */
+void job_launched(Job *job) {
+    if (job->background) {
+        pid_t last = -1;
+        for (int k = 0; k < job->proc_count; k++) {
+            if (job->procs[k].pid != -1) {
+                last = job->procs[k].pid;
+            }
+        }
+        fprintf(stderr, "[%d] %d\n", job->id, (int)last);
+    }
+}
+
+/* Wait for 'job' through the event loop, reaping any other child that exits meanwhile.
+ * A foreground job gets the terminal while it runs. Returns the pipefail status,
+ * or 128 + SIGTSTP if the job was stopped (it then stays in the table as a background job).
+ * Every process (status, resource usage, start and end time) is copied to 'procs'
+ * when it is not NULL.
+ */
+int job_wait(Job *job, JobProcess *procs) {
+    int give_terminal = job_control && !job->background && job->pgid > 0;
+
+    if (give_terminal) {
+        tcsetpgrp(STDIN_FILENO, job->pgid);
+    }
+    while (job->state == JOB_RUNNING) {
+        jobs_poll(-1);
+    }
+    if (give_terminal) {
+        tcsetpgrp(STDIN_FILENO, shell_pgid);
+    }
+
+    if (procs != NULL) {
+        memcpy(procs, job->procs, job->proc_count * sizeof(JobProcess));
+    }
+    if (job->state == JOB_STOPPED) {
+        job->background = 1;
+        fprintf(stderr, "\n[%d]+  Stopped                 %s\n", job->id, job->command);
+        return 128 + SIGTSTP;
+    }
+
+    int status = job_status(job);
+    remove_job(job);
+    return status;
+}
+
+/* Handle child events for up to 'timeout_ms' (-1 to block).
+ * Returns 1 if the descriptor registered by jobs_wait_input became readable.
+ */
+int jobs_poll(int timeout_ms) {
+    struct epoll_event events[JOBS_MAX_EVENTS];
+    int n = epoll_wait(epoll_fd, events, JOBS_MAX_EVENTS, timeout_ms);
+    int ready = 0;
+
+    for (int k = 0; k < n; k++) {
+        void *ptr = events[k].data.ptr;
+        if (ptr == &sigchld_marker) {
+            handle_sigchld();
+        } else if (ptr == &input_marker) {
+            input_ready = 1;
+        } else {
+            JobProcess *proc = ptr;
+            if (!proc->done) {
+                reap_process(proc, 0);
+            }
+        }
+    }
+    if (input_ready) {
+        input_ready = 0;
+        ready = 1;
+    }
+    return ready;
+}
+
+/* Block until 'fd' is readable while still reaping children as they exit.
+ * Used by the line reader before every read. Descriptors epoll cannot watch
+ * (regular files, so every script) never block: finished jobs are reaped and
+ * reported without waiting, and the refused descriptor is not offered again.
+ */
+int jobs_wait_input(int fd) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = &input_marker;
+
+    if (epoll_fd == -1) {
+        return 0;
+    }
+    if (fd != input_fd) {
+        input_fd = fd;
+        input_pollable = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+    } else if (input_pollable && epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        input_pollable = 0;
+    }
+    if (!input_pollable) {
+        jobs_poll(0);
+        jobs_notify();
+        return 0;
+    }
+
+    while (!jobs_poll(-1)) {
+        jobs_notify();
+    }
+    return 0;
+}
+
+/* Report finished background jobs once and drop them from the table */
+void jobs_notify(void) {
+    Job *job = job_list;
+    while (job != NULL) {
+        Job *next = job->next;
+        if (job->state == JOB_DONE && job->background) {
+            int status = job_status(job);
+            if (status == 0) {
+                fprintf(stderr, "[%d]   Done                    %s\n", job->id, job->command);
+            } else {
+                fprintf(stderr, "[%d]   Exit %-3d                %s\n", job->id, status, job->command);
+            }
+            remove_job(job);
+        }
+        job = next;
+    }
+}
+
+void jobs_print(void) {
+    jobs_poll(0);
+    for (Job *job = job_list; job != NULL; job = job->next) {
+        printf("[%d]%c  %-22s %s\n", job->id, job->next == NULL ? '+' : ' ', state_name(job), job->command);
+    }
+    fflush(stdout);
+    jobs_notify();
+}
+
+/* Find a job from "%n" (its job number) or a plain number (the pid of one of its
+ * processes), as fg, bg and wait take them. NULL 'spec' means the current job.
+ */
+Job *job_find(const char *spec) {
+    if (spec == NULL || strcmp(spec, "%+") == 0 || strcmp(spec, "%%") == 0) {
+        Job *last = job_list;
+        while (last != NULL && last->next != NULL) {
+            last = last->next;
+        }
+        return last;
+    }
+
+    int by_id = (spec[0] == '%');
+    const char *digits = by_id ? spec + 1 : spec;
+    char *end;
+    long value = strtol(digits, &end, 10);
+    if (end == digits || *end != '\0') {
+        return NULL;
+    }
+    for (Job *job = job_list; job != NULL; job = job->next) {
+        if (by_id) {
+            if (job->id == value) {
+                return job;
+            }
+            continue;
+        }
+        for (int k = 0; k < job->proc_count; k++) {
+            if (job->procs[k].pid == value) {
+                return job;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Continue 'job' in the foreground and wait for it */
+int job_foreground(Job *job) {
+    printf("%s\n", job->command);
+    fflush(stdout);
+    job->background = 0;
+    if (job->state == JOB_STOPPED) {
+        job->state = JOB_RUNNING;
+        signal_job(job, SIGCONT);
+    }
+    return job_wait(job, NULL);
+}
+
+/* Continue a stopped 'job' in the background */
+int job_background(Job *job) {
+    job->background = 1;
+    if (job->state == JOB_STOPPED) {
+        job->state = JOB_RUNNING;
+        signal_job(job, SIGCONT);
+    }
+    fprintf(stderr, "[%d]+ %s &\n", job->id, job->command);
+    return 0;
+}
+
+/* Wait for every job that is not stopped, returns the status of the last one */
+int jobs_wait_all(void) {
+    int status = 0;
+    Job *job = job_list;
+    while (job != NULL) {
+        Job *next = job->next;
+        if (job->state != JOB_STOPPED) {
+            job->background = 1;  // wait never hands the terminal over
+            status = job_wait(job, NULL);
+        }
+        job = next;
+    }
+    return status;
+}
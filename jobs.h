@@ -0,0 +1,57 @@
+/*
+Author: Assem Samy
+File: jobs.h
+Comment: Job table and the pidfd/epoll event loop that reaps children without blocking the shell
+*/
+
+#ifndef JOBS_H
+#define JOBS_H
+/*-----------------includes section--------------*/
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <time.h>
+/*----------------macros declarations-----------------*/
+#define JOB_RUNNING  0
+#define JOB_STOPPED  1
+#define JOB_DONE     2
+#define JOBS_MAX_EVENTS 32   // epoll events handled per wakeup
+/*-----------------types declarations-----------------*/
+struct Job;
+
+typedef struct {
+    struct Job *job;   // Owning job, used when the pidfd fires
+    pid_t pid;         // -1 if the process never started
+    int pidfd;         // -1 when pidfd_open is not available
+    int status;        // Shell exit status once done (128 + signal when killed)
+    int done;
+    struct rusage usage;       // Resources used, filled by wait4 when the process is reaped
+    struct timespec started;   // CLOCK_MONOTONIC at launch and at reap, for the wall time
+    struct timespec finished;
+} JobProcess;
+
+typedef struct Job {
+    struct Job *next;
+    int id;                // Number shown as [id] and used by %id
+    pid_t pgid;            // Process group when job control is on, 0 otherwise (set by the launcher)
+    int state;             // JOB_RUNNING, JOB_STOPPED or JOB_DONE
+    int background;
+    char *command;         // Text shown by jobs
+    JobProcess *procs;     // One per pipeline stage, allocated once
+    int proc_count;
+} Job;
+/*-----------section contains functions declarations------------*/
+void jobs_init(int interactive);
+int jobs_control_enabled(void);
+Job *job_create(const char *command, int proc_count, int background);
+void job_set_process(Job *job, int index, pid_t pid, int status);
+void job_launched(Job *job);
+int job_wait(Job *job, JobProcess *procs);
+int jobs_poll(int timeout_ms);
+int jobs_wait_input(int fd);
+void jobs_notify(void);
+void jobs_print(void);
+Job *job_find(const char *spec);
+int job_foreground(Job *job);
+int job_background(Job *job);
+int jobs_wait_all(void);
+#endif
@@ -0,0 +1,90 @@
+/*
+Author: Assem Samy
+File: launch.c
+Comment: Starts external commands with posix_spawn, redirections and pipe ends become spawn file actions
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "launch.h"
+#include <signal.h>
+#include <spawn.h>
+
+/*-----------Section Contains Function Definitions------------*/
+
+void launch_options_init(LaunchOptions *opts) {
+    opts->input_file = NULL;
+    opts->output_file = NULL;
+    opts->error_file = NULL;
+    opts->stdin_fd = -1;
+    opts->stdout_fd = -1;
+    opts->pgid = -1;
+}
+
+/* Start 'path' with 'argv' and return the child pid, or -1 after printing the reason.
+ * glibc implements posix_spawn with clone(CLONE_VM | CLONE_VFORK), so the shell's page
+ * tables are never copied and launch cost does not grow with the shell's RSS.
+ * Pipe descriptors should be created with O_CLOEXEC: the dup2 onto 0/1 clears the flag
+ * for the copy while the originals disappear at exec.
+ * Pipe ends are applied before file redirections, so "cmd < file" wins over a pipe like in sh.
+ * The child always starts with an empty signal mask and default job control signals,
+ * whatever the shell blocks (SIGCHLD) or ignores (^C, ^Z) for itself.
+ */
+pid_t launch_process(const char *path, char *const argv[], const LaunchOptions *opts) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t empty, defaults;
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+    pid_t pid;
+    int err;
+
+    posix_spawnattr_init(&attr);
+    sigemptyset(&empty);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGQUIT);
+    sigaddset(&defaults, SIGTSTP);
+    sigaddset(&defaults, SIGTTIN);
+    sigaddset(&defaults, SIGTTOU);
+    sigaddset(&defaults, SIGCHLD);
+    posix_spawnattr_setsigmask(&attr, &empty);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    if (opts != NULL && opts->pgid >= 0) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, opts->pgid);
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    posix_spawn_file_actions_init(&actions);
+    if (opts != NULL) {
+        if (opts->stdin_fd >= 0) {
+            posix_spawn_file_actions_adddup2(&actions, opts->stdin_fd, STDIN_FILENO);
+        }
+        if (opts->stdout_fd >= 0) {
+            posix_spawn_file_actions_adddup2(&actions, opts->stdout_fd, STDOUT_FILENO);
+        }
+        if (opts->input_file != NULL) {
+            posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, opts->input_file, O_RDONLY, 0);
+        }
+        if (opts->output_file != NULL) {
+            posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, opts->output_file,
+                                             O_WRONLY | O_CREAT | O_TRUNC, LAUNCH_FILE_MODE);
+        }
+        if (opts->error_file != NULL) {
+            posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, opts->error_file,
+                                             O_WRONLY | O_CREAT | O_TRUNC, LAUNCH_FILE_MODE);
+        }
+    }
+
+    // Anything still buffered would otherwise show up after the child's output
+    fflush(stdout);
+
+    err = posix_spawn(&pid, path, &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (err != 0) {
+        fprintf(stderr, "%s: %s\n", argv[0], strerror(err));
+        return -1;
+    }
+    return pid;
+}
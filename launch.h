@@ -0,0 +1,25 @@
+/*
+Author: Assem Samy
+File: launch.h
+Comment: Shared process launcher built on posix_spawn, used by every exec path of the shell
+*/
+
+#ifndef LAUNCH_H
+#define LAUNCH_H
+/*-----------------includes section--------------*/
+#include <sys/types.h>
+/*----------------macros declarations-----------------*/
+#define LAUNCH_FILE_MODE (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)   // Mode of files created by > and 2>
+/*-----------------types declarations-----------------*/
+typedef struct {
+    const char *input_file;    // < file, NULL to inherit stdin
+    const char *output_file;   // > file, NULL to inherit stdout
+    const char *error_file;    // 2> file, NULL to inherit stderr
+    int stdin_fd;              // Descriptor placed on stdin (pipe read end), -1 for none
+    int stdout_fd;             // Descriptor placed on stdout (pipe write end), -1 for none
+    pid_t pgid;                // Process group: -1 keeps the shell's, 0 starts a new one, >0 joins it
+} LaunchOptions;
+/*-----------section contains functions declarations------------*/
+void launch_options_init(LaunchOptions *opts);
+pid_t launch_process(const char *path, char *const argv[], const LaunchOptions *opts);
+#endif
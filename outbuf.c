@@ -0,0 +1,222 @@
+/*
+Author: Assem Samy
+File: outbuf.c
+Comment: Bulk output writer for myls, hand-rolled number and padding formatters and a per-minute timestamp memo
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "outbuf.h"
+#include <sys/uio.h>
+
+/*-----------------static functions---------------*/
+#define OUT_TIME_EMPTY LONG_MIN   // minute of a slot that holds nothing yet
+
+/* writev until everything is written, the vector is consumed in place */
+static int write_vector(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+/* Write the buffer and 'length' more bytes from 'data' in one writev */
+static void write_out(OutBuffer *out, const char *data, size_t length) {
+    struct iovec iov[2] = {
+        { out->data, out->used },
+        { (void *)data, length },
+    };
+    if (out->error == 0 && write_vector(out->fd, iov, 2) == -1) {
+        out->error = errno;
+    }
+    out->used = 0;
+}
+
+static void put_digits(char *p, int value, int digits) {
+    while (digits-- > 0) {
+        p[digits] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+/* "%Y-%m-%d %H:%M" of 't' in local time into 'text' (32 bytes), returns its length,
+ * 0 if localtime_r fails. 'cacheable' is set for the usual 16-character form, and left
+ * clear for zones with a UTC offset that is not whole minutes (old local mean times),
+ * where one t / 60 minute can span two local minutes.
+ */
+static int format_minute(time_t t, char *text, int *cacheable) {
+    struct tm tm;
+    if (localtime_r(&t, &tm) == NULL) {
+        return 0;
+    }
+    int year = tm.tm_year + 1900;
+    if (year < 0 || year > 9999) {
+        return strftime(text, 32, "%Y-%m-%d %H:%M", &tm);
+    }
+    put_digits(text, year, 4);
+    text[4] = '-';
+    put_digits(text + 5, tm.tm_mon + 1, 2);
+    text[7] = '-';
+    put_digits(text + 8, tm.tm_mday, 2);
+    text[10] = ' ';
+    put_digits(text + 11, tm.tm_hour, 2);
+    text[13] = ':';
+    put_digits(text + 14, tm.tm_min, 2);
+    *cacheable = (tm.tm_gmtoff % 60 == 0);
+    return OUT_TIME_LENGTH;
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Start a listing on 'fd'. Anything stdio still holds for stdout goes first, so the
+ * listing lands after it. Without memory for the buffer the listing is still written,
+ * through the small spare buffer inside 'out'.
+ */
+void out_init(OutBuffer *out, int fd) {
+    if (fd == STDOUT_FILENO) {
+        fflush(stdout);
+    }
+    out->fd = fd;
+    out->used = 0;
+    out->error = 0;
+    out->size = OUT_BUFFER_SIZE;
+    out->data = malloc(OUT_BUFFER_SIZE);
+    if (out->data == NULL) {
+        out->size = OUT_SPARE_SIZE;
+        out->data = out->spare;
+    }
+    for (int k = 0; k < OUT_TIME_SLOTS; k++) {
+        out->times[k].minute = OUT_TIME_EMPTY;
+    }
+}
+
+/* Append 'length' bytes. What does not fit goes out together with the buffer in
+ * one writev, without being copied.
+ */
+void out_bytes(OutBuffer *out, const char *data, size_t length) {
+    if (out->size - out->used < length) {
+        write_out(out, data, length);
+        return;
+    }
+    memcpy(out->data + out->used, data, length);
+    out->used += length;
+}
+
+void out_char(OutBuffer *out, char c) {
+    if (out->used == out->size) {
+        write_out(out, NULL, 0);
+    }
+    out->data[out->used++] = c;
+}
+
+void out_spaces(OutBuffer *out, int count) {
+    static const char spaces[] = "                                                                ";
+    while (count > 0) {
+        int n = (count < (int)sizeof(spaces) - 1) ? count : (int)sizeof(spaces) - 1;
+        out_bytes(out, spaces, n);
+        count -= n;
+    }
+}
+
+/* 'text' left-justified in at least 'width' columns, like printf("%-*s") */
+void out_str(OutBuffer *out, const char *text, int width) {
+    size_t length = strlen(text);
+    out_bytes(out, text, length);
+    if ((size_t)width > length) {
+        out_spaces(out, width - (int)length);
+    }
+}
+
+/* Left-justified in at least 'width' columns, like printf("%-*lu") */
+void out_ulong(OutBuffer *out, unsigned long value, int width) {
+    char digits[24];
+    int k = sizeof(digits);
+    do {
+        digits[--k] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    int length = sizeof(digits) - k;
+    out_bytes(out, digits + k, length);
+    if (width > length) {
+        out_spaces(out, width - length);
+    }
+}
+
+/* Left-justified in at least 'width' columns, like printf("%-*ld") */
+void out_long(OutBuffer *out, long value, int width) {
+    if (value < 0) {
+        out_char(out, '-');
+        out_ulong(out, -(unsigned long)value, width - 1);
+    } else {
+        out_ulong(out, (unsigned long)value, width);
+    }
+}
+
+/* 't' as "%Y-%m-%d %H:%M" in local time, left-justified in 'width' columns.
+ * A listing has far fewer distinct minutes than files, so each formatted minute is
+ * kept in a small direct-mapped memo: most rows cost a division and a copy instead
+ * of localtime() and strftime(). Nothing is printed if the time cannot be converted.
+ */
+void out_time(OutBuffer *out, time_t t, int width) {
+    time_t minute = (t >= 0) ? t / 60 : -((-(t + 1)) / 60) - 1;   // Rounded down for times before 1970
+    OutTimeSlot *slot = &out->times[(unsigned long)minute & (OUT_TIME_SLOTS - 1)];
+    char text[32];
+    int length;
+
+    if (slot->minute == minute) {
+        out_bytes(out, slot->text, OUT_TIME_LENGTH);
+        length = OUT_TIME_LENGTH;
+    } else {
+        int cacheable = 0;
+        length = format_minute(t, text, &cacheable);
+        if (cacheable) {
+            slot->minute = minute;
+            memcpy(slot->text, text, OUT_TIME_LENGTH);
+        }
+        out_bytes(out, text, length);
+    }
+    if (width > length) {
+        out_spaces(out, width - length);
+    }
+}
+
+/* Write what is buffered. Returns 0, or -1 with errno set if any write of this
+ * listing failed (a closed pipe, a full disk).
+ */
+int out_flush(OutBuffer *out) {
+    if (out->used > 0) {
+        write_out(out, NULL, 0);
+    }
+    if (out->error != 0) {
+        errno = out->error;
+        return -1;
+    }
+    return 0;
+}
+
+/* Flush and release the buffer, returns like out_flush() */
+int out_close(OutBuffer *out) {
+    int rc = out_flush(out);
+    int err = errno;
+    if (out->data != out->spare) {
+        free(out->data);
+    }
+    out->data = NULL;
+    errno = err;
+    return rc;
+}
@@ -0,0 +1,44 @@
+/*
+Author: Assem Samy
+File: outbuf.h
+Comment: Bulk output writer for listings, rows are formatted straight into a large buffer and written with writev
+*/
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+/*-----------------includes section--------------*/
+#include <sys/types.h>
+#include <time.h>
+/*----------------macros declarations-----------------*/
+#define OUT_BUFFER_SIZE  (64 * 1024)   // Bytes per write, hundreds of rows
+#define OUT_SPARE_SIZE   256           // Used instead when the buffer cannot be allocated, a row or two per write
+#define OUT_TIME_SLOTS   64            // Minutes remembered by out_time(), power of two
+#define OUT_TIME_LENGTH  16            // "YYYY-MM-DD HH:MM"
+/*-----------------types declarations-----------------*/
+/* A formatted minute, see out_time() */
+typedef struct {
+    time_t minute;                     // t / 60, -1 for an empty slot
+    char text[OUT_TIME_LENGTH];
+} OutTimeSlot;
+
+typedef struct {
+    int fd;
+    char *data;                        // The malloc'ed buffer, or 'spare'
+    size_t size;
+    size_t used;
+    int error;                         // errno of the first failed write, later output is dropped
+    OutTimeSlot times[OUT_TIME_SLOTS];
+    char spare[OUT_SPARE_SIZE];
+} OutBuffer;
+/*-----------section contains functions declarations------------*/
+void out_init(OutBuffer *out, int fd);
+void out_bytes(OutBuffer *out, const char *data, size_t length);
+void out_str(OutBuffer *out, const char *text, int width);
+void out_char(OutBuffer *out, char c);
+void out_spaces(OutBuffer *out, int count);
+void out_long(OutBuffer *out, long value, int width);
+void out_ulong(OutBuffer *out, unsigned long value, int width);
+void out_time(OutBuffer *out, time_t t, int width);
+int out_flush(OutBuffer *out);
+int out_close(OutBuffer *out);
+#endif
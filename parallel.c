@@ -0,0 +1,441 @@
+/*
+Author: Assem Samy
+File: parallel.c
+Comment: myparallel, packs input lines into as few execs as ARG_MAX allows and runs them on a pool of workers
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "parallel.h"
+#include "reader.h"
+#include "arena.h"
+#include "pathcache.h"
+#include "launch.h"
+#include "pipeline.h"
+#include "jobs.h"
+#include "trace.h"
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+
+/*-----------------types and static functions---------------*/
+typedef struct {
+    size_t first;      // Index of the first item passed to this job
+    size_t count;      // Number of items appended to the template
+    Job *job;          // NULL once the job has been collected
+    int out_fd;        // memfd holding the job's stdout when output is kept in order, else -1
+    double start;
+    double end;
+    int status;
+    int done;
+} ParallelBatch;
+
+typedef struct {
+    char **items;      // One argument per input line, stored in 'arena'
+    size_t count;
+    size_t capacity;
+    Arena arena;
+} ParallelInput;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Read every non-empty line of 'reader' as one argument */
+static int read_items(LineReader *reader, ParallelInput *in) {
+    char *line;
+    ssize_t len;
+
+    while ((len = line_reader_next(reader, &line)) >= 0) {
+        if (len == 0) {
+            continue;
+        }
+        if (in->count == in->capacity) {
+            size_t new_capacity = in->capacity ? in->capacity * 2 : INITIAL_CAPACITY;
+            char **new_items = realloc(in->items, new_capacity * sizeof(char *));
+            if (new_items == NULL) {
+                perror("malloc failed");
+                return -1;
+            }
+            in->items = new_items;
+            in->capacity = new_capacity;
+        }
+        char *item = arena_alloc(&in->arena, len + 1);
+        if (item == NULL) {
+            perror("malloc failed");
+            return -1;
+        }
+        memcpy(item, line, len + 1);
+        in->items[in->count++] = item;
+    }
+    if (len == -2) {
+        perror("myparallel: read");
+        return -1;
+    }
+    return 0;
+}
+
+/* Copy the template words into 'arena'. They point into the shell's line buffer, which
+ * read_input() moves or reallocates when it reads the rest of a piped script.
+ */
+static int copy_template(char ***template, int template_count, Arena *arena) {
+    char **words = arena_alloc(arena, template_count * sizeof(char *));
+    if (words == NULL) {
+        perror("malloc failed");
+        return -1;
+    }
+    for (int k = 0; k < template_count; k++) {
+        size_t len = strlen((*template)[k]) + 1;
+        words[k] = arena_alloc(arena, len);
+        if (words[k] == NULL) {
+            perror("malloc failed");
+            return -1;
+        }
+        memcpy(words[k], (*template)[k], len);
+    }
+    *template = words;
+    return 0;
+}
+
+/* Read the items from 'fd', or from the shell's own reader when it is 'fd'.
+ * A piped script has already buffered the lines after the myparallel command,
+ * so those lines are the items and the shell does not run them.
+ */
+static int read_input(int fd, ParallelInput *in) {
+    LineReader *shared = fd == STDIN ? line_reader_stdin() : NULL;
+    LineReader reader;
+
+    if (shared != NULL) {
+        return read_items(shared, in);
+    }
+    if (line_reader_init(&reader, fd) == -1) {
+        perror("malloc failed");
+        return -1;
+    }
+    int rc = read_items(&reader, in);
+    line_reader_free(&reader);
+    return rc;
+}
+
+/* Bytes an argument list may use in one exec: ARG_MAX minus the environment,
+ * the command template and some headroom. Each argument costs its text plus its pointer.
+ */
+static long argument_budget(char **template, int template_count) {
+    long budget = sysconf(_SC_ARG_MAX);
+    if (budget <= 0) {
+        budget = 128 * 1024;  // POSIX lower bound used by older kernels
+    }
+    budget -= PARALLEL_ARG_HEADROOM;
+    for (char **env = environ; *env != NULL; env++) {
+        budget -= strlen(*env) + 1 + sizeof(char *);
+    }
+    for (int k = 0; k < template_count; k++) {
+        budget -= strlen(template[k]) + 1 + sizeof(char *);
+    }
+    return budget;
+}
+
+/* Cut the items into batches. A batch takes at most 'max_args' items and never more
+ * than fits in 'budget' bytes; an item too long for any batch still gets its own
+ * so exec reports the error. Returns the number of batches.
+ */
+static size_t split_batches(const ParallelInput *in, size_t max_args, long budget, ParallelBatch *batches) {
+    size_t n = 0;
+    size_t k = 0;
+
+    while (k < in->count) {
+        long used = 0;
+        ParallelBatch *b = &batches[n++];
+        memset(b, 0, sizeof(*b));
+        b->first = k;
+        b->out_fd = -1;
+        while (k < in->count && b->count < max_args) {
+            long cost = strlen(in->items[k]) + 1 + sizeof(char *);
+            if (b->count > 0 && used + cost > budget) {
+                break;
+            }
+            used += cost;
+            b->count++;
+            k++;
+        }
+    }
+    return n;
+}
+
+/* Start one batch as a single-process job: template words followed by its items.
+ * Returns -1 if no job could be created (the batch is then already done).
+ */
+static int start_batch(ParallelBatch *b, const ParallelInput *in, char **template, int template_count,
+                        const char *path, const char *text, int keep_order) {
+    char **argv = malloc((template_count + b->count + 1) * sizeof(char *));
+    pid_t pid = -1;
+
+    b->start = now_seconds();
+    b->job = job_create(text, 1, 0);
+    if (b->job == NULL) {
+        free(argv);
+        b->status = PIPELINE_STATUS_NOT_FOUND;
+        b->done = 1;
+        b->end = b->start;
+        return -1;
+    }
+    if (argv == NULL) {
+        perror("malloc failed");
+        job_set_process(b->job, 0, -1, PIPELINE_STATUS_NOT_FOUND);  // Collected like any failed job
+        return 0;
+    }
+
+    memcpy(argv, template, template_count * sizeof(char *));
+    memcpy(argv + template_count, in->items + b->first, b->count * sizeof(char *));
+    argv[template_count + b->count] = NULL;
+
+    LaunchOptions opts;
+    launch_options_init(&opts);
+    if (keep_order) {
+        b->out_fd = memfd_create("myparallel", MFD_CLOEXEC);
+        if (b->out_fd == -1) {
+            perror("myparallel: memfd_create");  // Output of this job goes straight to stdout
+        }
+        opts.stdout_fd = b->out_fd;
+    }
+    if (path != NULL) {
+        pid = launch_process(path, argv, &opts);
+    }
+    job_set_process(b->job, 0, pid, PIPELINE_STATUS_NOT_FOUND);
+    free(argv);
+    return 0;
+}
+
+/* Collect a job whose process is gone and record its status */
+static void finish_batch(ParallelBatch *b, size_t index, int timing) {
+    b->status = job_wait(b->job, NULL);
+    b->job = NULL;
+    b->done = 1;
+    b->end = now_seconds();
+    TRACE(TRACE_DEBUG, "myparallel job %zu exited with status %d", index + 1, b->status);
+    if (timing) {
+        fprintf(stderr, "myparallel: job %zu: %zu args, %.3f s, status %d\n",
+                index + 1, b->count, b->end - b->start, b->status);
+    }
+}
+
+/* Copy a finished job's buffered output to stdout and release the buffer */
+static void flush_output(ParallelBatch *b) {
+    if (b->out_fd == -1) {
+        return;
+    }
+    off_t size = lseek(b->out_fd, 0, SEEK_END);
+    off_t offset = 0;
+
+    fflush(stdout);
+    while (offset < size) {
+        ssize_t n = sendfile(STDOUT, b->out_fd, &offset, size - offset);
+        if (n > 0) {
+            continue;
+        }
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 && (errno == EINVAL || errno == ENOSYS)) {
+            // stdout does not accept sendfile (e.g. opened with O_APPEND), copy by hand
+            char buffer[BUF_SIZE];
+            ssize_t r;
+            while ((r = pread(b->out_fd, buffer, sizeof(buffer), offset)) > 0) {
+                if (write(STDOUT, buffer, r) != r) {
+                    break;
+                }
+                offset += r;
+            }
+        } else if (n == -1) {
+            perror("myparallel: write");
+        }
+        break;
+    }
+    close(b->out_fd);
+    b->out_fd = -1;
+}
+
+/* Words of the template joined with spaces, shown by jobs while a batch runs */
+static char *template_text(char **template, int template_count) {
+    size_t len = sizeof(" ...");
+    for (int k = 0; k < template_count; k++) {
+        len += strlen(template[k]) + 1;
+    }
+    char *text = malloc(len);
+    if (text == NULL) {
+        return NULL;
+    }
+    char *p = text;
+    for (int k = 0; k < template_count; k++) {
+        p = stpcpy(p, template[k]);
+        *p++ = ' ';
+    }
+    strcpy(p, "...");
+    return text;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: myparallel [-j workers] [-n max_args] [-a file] [-k] [-t] command [args...]\n");
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* myparallel [-j workers] [-n max_args] [-a file] [-k] [-t] command [args...]
+ * Every non-empty line of stdin (or of -a file) becomes one argument appended to the
+ * command; in a piped script, stdin is the rest of the script. Arguments are packed
+ * into as few commands as ARG_MAX allows, spread over the workers when -n is not
+ * given. -j sets the number of commands run at once (default: online CPUs), -k prints
+ * each command's output in input order and -t reports the time of every command.
+ * Returns 0, or 123 if any command failed.
+ */
+int parallel_command(int argc, char **argv) {
+    int workers = get_nprocs();
+    size_t max_args = 0;
+    const char *input_file = NULL;
+    int keep_order = 0;
+    int timing = 0;
+    int opt;
+
+    optind = 0;  // Full getopt reset, '+' stops at the command so its own options are kept
+    while ((opt = getopt(argc, argv, "+j:n:a:kt")) != -1) {
+        switch (opt) {
+            case 'j':
+                workers = atoi(optarg);
+                break;
+            case 'n':
+                max_args = strtoul(optarg, NULL, 10);
+                break;
+            case 'a':
+                input_file = optarg;
+                break;
+            case 'k':
+                keep_order = 1;
+                break;
+            case 't':
+                timing = 1;
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if (optind >= argc || workers <= 0) {
+        usage();
+        return 1;
+    }
+    char **template = argv + optind;
+    int template_count = argc - optind;
+
+    long budget = argument_budget(template, template_count);
+    if (budget <= 0) {
+        fprintf(stderr, "myparallel: environment and command leave no room for arguments\n");
+        return 1;
+    }
+
+    int fd = STDIN;
+    if (input_file != NULL) {
+        fd = open(input_file, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            perror(input_file);
+            return 1;
+        }
+    }
+
+    ParallelInput in = {0};
+    arena_init(&in.arena);
+    int rc = copy_template(&template, template_count, &in.arena);
+    if (rc == 0) {
+        rc = read_input(fd, &in);
+    }
+    if (fd != STDIN) {
+        close(fd);
+    }
+    if (rc == -1 || in.count == 0) {
+        free(in.items);
+        arena_free(&in.arena);
+        return rc == -1 ? 1 : 0;
+    }
+
+    // Without -n, spread the items so every worker has a command to run
+    if (max_args == 0) {
+        max_args = (in.count + workers - 1) / workers;
+    }
+
+    ParallelBatch *batches = malloc(in.count * sizeof(ParallelBatch));
+    char *text = template_text(template, template_count);
+    if (batches == NULL || text == NULL) {
+        perror("malloc failed");
+        free(batches);
+        free(text);
+        free(in.items);
+        arena_free(&in.arena);
+        return 1;
+    }
+    size_t batch_count = split_batches(&in, max_args, budget, batches);
+
+    // Resolved once for every batch
+    const char *resolved = path_cache_resolve(template[0]);
+    char *path = resolved != NULL ? strdup(resolved) : NULL;
+    if (path == NULL) {
+        fprintf(stderr, "%s: command not found\n", template[0]);
+    }
+
+    double start = now_seconds();
+    size_t next = 0;       // Next batch to start
+    size_t oldest = 0;     // Every batch before this one is collected
+    size_t printed = 0;    // Every batch before this one has its output written
+    int running = 0;
+    int status = 0;
+    double busy = 0;
+
+    while (oldest < batch_count) {
+        while (running < workers && next < batch_count) {
+            if (start_batch(&batches[next], &in, template, template_count, path, text, keep_order) == 0) {
+                running++;
+            } else {
+                status = PARALLEL_STATUS_FAILED;
+            }
+            next++;
+        }
+
+        int collected = 0;
+        for (size_t k = oldest; k < next; k++) {
+            ParallelBatch *b = &batches[k];
+            if (b->done || b->job == NULL || b->job->state == JOB_RUNNING) {
+                continue;
+            }
+            finish_batch(b, k, timing);
+            busy += b->end - b->start;
+            if (b->status != 0) {
+                status = PARALLEL_STATUS_FAILED;
+            }
+            running--;
+            collected++;
+        }
+        while (oldest < next && batches[oldest].done) {
+            oldest++;
+        }
+        if (keep_order) {
+            while (printed < oldest) {
+                flush_output(&batches[printed++]);
+            }
+        }
+        if (collected == 0) {
+            jobs_poll(-1);
+        }
+    }
+
+    if (timing) {
+        double wall = now_seconds() - start;
+        fprintf(stderr, "myparallel: %zu jobs, %zu args, %d workers, %.3f s wall, %.3f s busy (%.1fx)\n",
+                batch_count, in.count, workers, wall, busy, wall > 0 ? busy / wall : 0.0);
+    }
+
+    free(path);
+    free(text);
+    free(batches);
+    free(in.items);
+    arena_free(&in.arena);
+    return status;
+}
@@ -0,0 +1,16 @@
+/*
+Author: Assem Samy
+File: parallel.h
+Comment: myparallel, runs a command template over argument lists with a bounded pool of workers
+*/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+/*-----------------includes section--------------*/
+#include <stddef.h>
+/*----------------macros declarations-----------------*/
+#define PARALLEL_ARG_HEADROOM 2048   // Bytes of ARG_MAX kept free, as xargs does
+#define PARALLEL_STATUS_FAILED 123   // Returned when at least one job failed (xargs convention)
+/*-----------section contains functions declarations------------*/
+int parallel_command(int argc, char **argv);
+#endif
@@ -0,0 +1,221 @@
+/*
+Author: Assem Samy
+File: pathcache.c
+Comment: Resolves commands over $PATH once and remembers the result until PATH or a PATH directory changes
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "pathcache.h"
+
+/*-----------------variables and static functions---------------*/
+typedef struct PathEntry {
+    struct PathEntry *next;
+    char *name;            // Command name as typed
+    char *path;            // Resolved absolute path
+    int dir_index;         // Index of the PATH directory it was found in
+    unsigned long hits;    // Number of times the resolution was used
+} PathEntry;
+
+typedef struct {
+    char *dir;                 // Points into path_copy
+    struct timespec mtime;     // Directory mtime when last checked
+} PathDir;
+
+static PathEntry *buckets[PATH_CACHE_BUCKETS];
+static char *path_copy = NULL;    // Private copy of $PATH, split in place into dirs[]
+static char *path_value = NULL;   // Unmodified copy of $PATH, compared against getenv("PATH")
+static PathDir *dirs = NULL;
+static int dir_count = 0;
+static time_t last_check = 0;
+
+static unsigned int name_hash(const char *name) {
+    unsigned int h = 2166136261u;
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+    return h & (PATH_CACHE_BUCKETS - 1);
+}
+
+static void dir_mtime(const char *dir, struct timespec *mtime) {
+    struct stat info;
+    if (stat(dir, &info) == 0) {
+        *mtime = info.st_mtim;
+    } else {
+        mtime->tv_sec = 0;
+        mtime->tv_nsec = 0;
+    }
+}
+
+/* Drop cached entries found in PATH directory 'from_dir' or later (all of them for 0) */
+static void drop_entries(int from_dir) {
+    for (int b = 0; b < PATH_CACHE_BUCKETS; b++) {
+        PathEntry **link = &buckets[b];
+        while (*link != NULL) {
+            PathEntry *entry = *link;
+            if (entry->dir_index >= from_dir) {
+                *link = entry->next;
+                free(entry->name);
+                free(entry->path);
+                free(entry);
+            } else {
+                link = &entry->next;
+            }
+        }
+    }
+}
+
+/* Split $PATH into dirs[] and record every directory's mtime */
+static void load_path(const char *env) {
+    free(path_copy);
+    free(path_value);
+    free(dirs);
+    path_copy = strdup(env);
+    path_value = strdup(env);
+    dir_count = 0;
+    dirs = NULL;
+    if (path_copy == NULL || path_value == NULL) {
+        perror("Error allocating memory for PATH");
+        return;
+    }
+
+    int max_dirs = 1;
+    for (const char *p = env; *p; p++) {
+        if (*p == ':') {
+            max_dirs++;
+        }
+    }
+    dirs = malloc(max_dirs * sizeof(PathDir));
+    if (dirs == NULL) {
+        perror("Error allocating memory for PATH");
+        return;
+    }
+
+    char *saveptr;
+    for (char *dir = strtok_r(path_copy, ":", &saveptr); dir != NULL; dir = strtok_r(NULL, ":", &saveptr)) {
+        dirs[dir_count].dir = dir;
+        dir_mtime(dir, &dirs[dir_count].mtime);
+        dir_count++;
+    }
+    last_check = time(NULL);
+}
+
+/* Bring the cache in line with the current $PATH.
+ * A changed PATH empties the cache. A PATH directory whose mtime moved can hold a new
+ * command (shadowing later directories) or lose one, so entries from it onwards are dropped.
+ * Directory mtimes are checked at most once per PATH_CACHE_CHECK_INTERVAL.
+ */
+static void sync_with_path(void) {
+    const char *env = getenv("PATH");
+    if (env == NULL) {
+        env = "";
+    }
+
+    if (path_value == NULL || strcmp(env, path_value) != 0) {
+        drop_entries(0);
+        load_path(env);
+        return;
+    }
+
+    time_t now = time(NULL);
+    if (now - last_check < PATH_CACHE_CHECK_INTERVAL) {
+        return;
+    }
+    last_check = now;
+
+    for (int d = 0; d < dir_count; d++) {
+        struct timespec mtime;
+        dir_mtime(dirs[d].dir, &mtime);
+        if (mtime.tv_sec != dirs[d].mtime.tv_sec || mtime.tv_nsec != dirs[d].mtime.tv_nsec) {
+            drop_entries(d);
+            // Later directories are re-read on their next miss, refresh their mtimes now
+            for (int k = d; k < dir_count; k++) {
+                dir_mtime(dirs[k].dir, &dirs[k].mtime);
+            }
+            break;
+        }
+    }
+}
+
+/* Look 'command' up in every PATH directory, return the directory index or -1 */
+static int search_path(const char *command, char *full_path, size_t size) {
+    for (int d = 0; d < dir_count; d++) {
+        snprintf(full_path, size, "%s/%s", dirs[d].dir, command);
+        struct stat statbuf;
+        if (stat(full_path, &statbuf) == 0 && S_ISREG(statbuf.st_mode) && (statbuf.st_mode & S_IXUSR)) {
+            return d;
+        }
+    }
+    return -1;
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Return the absolute path 'command' runs from, or NULL if it is not found.
+ * Names containing '/' are returned unchanged, like execvp does.
+ * The returned string is owned by the cache and valid until the next call.
+ */
+const char *path_cache_resolve(const char *command) {
+    if (strchr(command, '/') != NULL) {
+        return command;
+    }
+
+    sync_with_path();
+
+    unsigned int b = name_hash(command);
+    for (PathEntry *entry = buckets[b]; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->name, command) == 0) {
+            entry->hits++;
+            return entry->path;
+        }
+    }
+
+    char full_path[PATH_MAX];
+    int d = search_path(command, full_path, sizeof(full_path));
+    if (d == -1) {
+        return NULL;
+    }
+
+    PathEntry *entry = malloc(sizeof(PathEntry));
+    if (entry == NULL) {
+        perror("malloc failed");
+        return NULL;
+    }
+    entry->name = strdup(command);
+    entry->path = strdup(full_path);
+    if (entry->name == NULL || entry->path == NULL) {
+        perror("malloc failed");
+        free(entry->name);
+        free(entry->path);
+        free(entry);
+        return NULL;
+    }
+    entry->dir_index = d;
+    entry->hits = 1;
+    entry->next = buckets[b];
+    buckets[b] = entry;
+    return entry->path;
+}
+
+/* Print every cached resolution with its hit count */
+void path_cache_print(void) {
+    int empty = 1;
+    for (int b = 0; b < PATH_CACHE_BUCKETS; b++) {
+        for (PathEntry *entry = buckets[b]; entry != NULL; entry = entry->next) {
+            if (empty) {
+                printf("hits    command\n");
+                empty = 0;
+            }
+            printf("%4lu    %s\n", entry->hits, entry->path);
+        }
+    }
+    if (empty) {
+        printf("myhash: hash table empty\n");
+    }
+}
+
+/* Forget every cached resolution */
+void path_cache_reset(void) {
+    drop_entries(0);
+}
@@ -0,0 +1,16 @@
+/*
+Author: Assem Samy
+File: pathcache.h
+Comment: Cache of command name -> absolute path resolutions over $PATH (shown and reset by myhash)
+*/
+
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+/*----------------macros declarations-----------------*/
+#define PATH_CACHE_BUCKETS        256   // Power of two
+#define PATH_CACHE_CHECK_INTERVAL 1     // Seconds between PATH directory mtime checks
+/*-----------section contains functions declarations------------*/
+const char *path_cache_resolve(const char *command);
+void path_cache_print(void);
+void path_cache_reset(void);
+#endif
@@ -0,0 +1,217 @@
+/*
+Author: Assem Samy
+File: pipeline.c
+Comment: Splits a tokenized line at '|' and runs all the stages connected by N-1 pipes
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "pipeline.h"
+#include "pathcache.h"
+#include "launch.h"
+#include "jobs.h"
+
+/*-----------------variables and static functions---------------*/
+static int pipe_size = 0;   // F_SETPIPE_SZ value for new pipes, 0 keeps the kernel default
+
+/* Fill one stage from tokens [from, to), returns -1 on a syntax error */
+static int parse_stage(TokenList *tl, size_t from, size_t to, PipelineStage *stage) {
+    stage->input_file = NULL;
+    stage->output_file = NULL;
+    stage->error_file = NULL;
+    stage->pid = -1;
+    stage->status = 0;
+
+    for (size_t k = from; k < to; k++) {
+        const Token *tok = &tl->tokens[k];
+        if (!token_is_redirection(tok)) {
+            continue;
+        }
+        if (k + 1 >= to || tl->tokens[k + 1].kind != TOKEN_WORD) {
+            fprintf(stderr, "syntax error: missing file name after '%s'\n", tok->start);
+            return -1;
+        }
+        const char *file = tl->tokens[k + 1].start;
+        if (tok->kind == TOKEN_REDIR_IN) {
+            stage->input_file = file;
+        } else if (tok->kind == TOKEN_REDIR_OUT) {
+            stage->output_file = file;
+        } else {
+            stage->error_file = file;
+        }
+        k++;  // Skip the file name
+    }
+
+    stage->argv = token_list_argv(tl, from, to, &stage->argc);
+    if (stage->argv == NULL) {
+        return -1;
+    }
+    if (stage->argc == 0) {
+        fprintf(stderr, "syntax error: empty command in pipeline\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* Text of the pipeline as shown by jobs, e.g. "sort -u | head" */
+static char *pipeline_text(const PipelineStage *stages, int count) {
+    size_t len = 1;
+    for (int i = 0; i < count; i++) {
+        for (int k = 0; k < stages[i].argc; k++) {
+            len += strlen(stages[i].argv[k]) + 1;
+        }
+        len += 2;
+    }
+
+    char *text = malloc(len);
+    if (text == NULL) {
+        return NULL;
+    }
+    char *p = text;
+    for (int i = 0; i < count; i++) {
+        if (i > 0) {
+            p = stpcpy(p, "| ");
+        }
+        for (int k = 0; k < stages[i].argc; k++) {
+            p = stpcpy(p, stages[i].argv[k]);
+            *p++ = ' ';
+        }
+    }
+    if (p > text) {
+        p--;  // Drop the trailing space
+    }
+    *p = '\0';
+    return text;
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Split tokens [from, to) at every '|' into stages allocated from the line arena.
+ * Returns the number of stages, or -1 on a syntax error.
+ */
+int pipeline_parse(TokenList *tl, size_t from, size_t to, PipelineStage **stages) {
+    int count = 1;
+    for (size_t k = from; k < to; k++) {
+        if (tl->tokens[k].kind == TOKEN_PIPE) {
+            count++;
+        }
+    }
+
+    *stages = arena_alloc(&tl->arena, count * sizeof(PipelineStage));
+    if (*stages == NULL) {
+        perror("malloc failed");
+        return -1;
+    }
+
+    int n = 0;
+    size_t stage_start = from;
+    for (size_t k = from; k <= to; k++) {
+        if (k == to || tl->tokens[k].kind == TOKEN_PIPE) {
+            if (parse_stage(tl, stage_start, k, &(*stages)[n]) == -1) {
+                return -1;
+            }
+            n++;
+            stage_start = k + 1;
+        }
+    }
+    return n;
+}
+
+/* Launch every stage in one pass, wiring count-1 pipes, as one job.
+ * Each stage's own redirections override the pipe on that descriptor.
+ * A foreground pipeline is waited for through the job event loop and every stage's
+ * status, resource usage and wall time are stored; the return value is the pipefail
+ * status (last failing stage, 0 if none).
+ * A background pipeline returns 0 right after launch and is reaped asynchronously.
+ */
+int pipeline_run(PipelineStage *stages, int count, int background) {
+    int prev_read = -1;  // Read end feeding the current stage
+    pid_t pgid = jobs_control_enabled() ? 0 : -1;
+
+    char *text = pipeline_text(stages, count);
+    Job *job = job_create(text != NULL ? text : stages[0].argv[0], count, background);
+    free(text);
+    if (job == NULL) {
+        return PIPELINE_STATUS_NOT_FOUND;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int fds[2] = {-1, -1};
+
+        stages[i].pid = -1;
+        stages[i].status = PIPELINE_STATUS_NOT_FOUND;
+
+        if (i < count - 1) {
+            if (pipe2(fds, O_CLOEXEC) == -1) {
+                perror("pipe");
+                for (int k = i; k < count; k++) {
+                    job_set_process(job, k, -1, PIPELINE_STATUS_NOT_FOUND);
+                }
+                break;
+            }
+            if (pipe_size > 0 && fcntl(fds[1], F_SETPIPE_SZ, pipe_size) == -1) {
+                perror("fcntl F_SETPIPE_SZ");
+            }
+        }
+
+        LaunchOptions opts;
+        launch_options_init(&opts);
+        opts.stdin_fd = prev_read;
+        opts.stdout_fd = fds[1];
+        opts.input_file = stages[i].input_file;
+        opts.output_file = stages[i].output_file;
+        opts.error_file = stages[i].error_file;
+        opts.pgid = pgid;
+
+        const char *path = path_cache_resolve(stages[i].argv[0]);
+        if (path == NULL) {
+            fprintf(stderr, "%s: command not found\n", stages[i].argv[0]);
+        } else {
+            stages[i].pid = launch_process(path, stages[i].argv, &opts);
+        }
+        if (stages[i].pid != -1 && pgid == 0) {
+            pgid = stages[i].pid;  // First started stage leads the process group
+            job->pgid = pgid;
+        }
+        job_set_process(job, i, stages[i].pid, PIPELINE_STATUS_NOT_FOUND);
+
+        // The children hold their own copies now
+        if (prev_read != -1) {
+            close(prev_read);
+        }
+        if (fds[1] != -1) {
+            close(fds[1]);
+        }
+        prev_read = fds[0];
+    }
+    if (prev_read != -1) {
+        close(prev_read);
+    }
+
+    job_launched(job);
+    if (background) {
+        return 0;
+    }
+
+    JobProcess procs[count];
+    int result = job_wait(job, procs);
+    for (int i = 0; i < count; i++) {
+        stages[i].status = procs[i].status;
+        stages[i].usage = procs[i].usage;
+        stages[i].elapsed = 0;
+        if (procs[i].done) {
+            stages[i].elapsed = (procs[i].finished.tv_sec - procs[i].started.tv_sec) +
+                                (procs[i].finished.tv_nsec - procs[i].started.tv_nsec) / 1e9;
+        }
+    }
+    return result;
+}
+
+/* Set the capacity requested for every pipe of later pipelines (0 for the kernel default) */
+void pipeline_set_pipe_size(int bytes) {
+    pipe_size = bytes;
+}
+
+int pipeline_get_pipe_size(void) {
+    return pipe_size;
+}
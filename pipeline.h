@@ -0,0 +1,32 @@
+/*
+Author: Assem Samy
+File: pipeline.h
+Comment: N-stage pipeline engine, every stage launched in one pass with its own redirections
+*/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+/*-----------------includes section--------------*/
+#include <sys/types.h>
+#include <sys/resource.h>
+#include "tokenizer.h"
+/*----------------macros declarations-----------------*/
+#define PIPELINE_STATUS_NOT_FOUND 127   // Status of a stage whose command could not be started
+/*-----------------types declarations-----------------*/
+typedef struct {
+    char **argv;               // NULL-terminated, points into the command line
+    int argc;
+    const char *input_file;    // < file for this stage, or NULL
+    const char *output_file;   // > file for this stage, or NULL
+    const char *error_file;    // 2> file for this stage, or NULL
+    pid_t pid;                 // Set by pipeline_run, -1 if the stage did not start
+    int status;                // Exit status (128 + signal number when killed), foreground only
+    struct rusage usage;       // Resources used by the stage, foreground only
+    double elapsed;            // Wall time from launch to exit in seconds, foreground only
+} PipelineStage;
+/*-----------section contains functions declarations------------*/
+int pipeline_parse(TokenList *tl, size_t from, size_t to, PipelineStage **stages);
+int pipeline_run(PipelineStage *stages, int count, int background);
+void pipeline_set_pipe_size(int bytes);
+int pipeline_get_pipe_size(void);
+#endif
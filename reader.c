@@ -0,0 +1,141 @@
+/*
+Author: Assem Samy
+File: reader.c
+Comment: Buffered line reader, splits one large read into many lines and supports lines of any length
+*/
+
+/*-----------------Includes Section--------------*/
+#include "reader.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*-----------------static functions---------------*/
+static LineReader *stdin_reader;  // The shell's own reader while it takes commands from stdin
+
+
+/* Make room for at least one more byte after 'end'.
+ * Consumed bytes are dropped first, the buffer only grows when a single line fills it.
+ */
+static int make_room(LineReader *lr) {
+    if (lr->start > 0) {
+        memmove(lr->buf, lr->buf + lr->start, lr->end - lr->start);
+        lr->end -= lr->start;
+        lr->start = 0;
+    }
+    if (lr->end + 1 >= lr->cap) {
+        size_t new_cap = lr->cap * 2;
+        char *new_buf = realloc(lr->buf, new_cap);
+        if (new_buf == NULL) {
+            return -1;
+        }
+        lr->buf = new_buf;
+        lr->cap = new_cap;
+    }
+    return 0;
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Prepare a reader that pulls its input from the descriptor 'fd' */
+int line_reader_init(LineReader *lr, int fd) {
+    lr->fd = fd;
+    lr->cap = READER_INITIAL_SIZE;
+    lr->buf = malloc(lr->cap);
+    lr->start = 0;
+    lr->end = 0;
+    lr->eof = 0;
+    lr->wait_input = NULL;
+    return lr->buf == NULL ? -1 : 0;
+}
+
+/* Prepare a reader over an in-memory string (used by 'shell -c') */
+int line_reader_init_mem(LineReader *lr, const char *text, size_t len) {
+    lr->fd = -1;
+    lr->cap = len + 1;
+    lr->buf = malloc(lr->cap);
+    if (lr->buf == NULL) {
+        return -1;
+    }
+    memcpy(lr->buf, text, len);
+    lr->start = 0;
+    lr->end = len;
+    lr->eof = 1;
+    lr->wait_input = NULL;
+    return 0;
+}
+
+/* Return the next line without its newline, NUL-terminated inside the reader buffer.
+ * The pointer stays valid until the next call.
+ * Returns the line length, -1 at end of input and -2 on a read error.
+ */
+ssize_t line_reader_next(LineReader *lr, char **line) {
+    size_t scanned = lr->start;
+
+    while (1) {
+        char *nl = memchr(lr->buf + scanned, '\n', lr->end - scanned);
+        if (nl != NULL) {
+            *nl = '\0';
+            *line = lr->buf + lr->start;
+            ssize_t len = nl - *line;
+            lr->start = (nl - lr->buf) + 1;
+            return len;
+        }
+
+        if (lr->eof) {
+            if (lr->start == lr->end) {
+                return -1;
+            }
+            // Last line without a trailing newline
+            if (lr->end >= lr->cap && make_room(lr) == -1) {
+                return -2;
+            }
+            lr->buf[lr->end] = '\0';
+            *line = lr->buf + lr->start;
+            ssize_t len = lr->end - lr->start;
+            lr->start = lr->end;
+            return len;
+        }
+
+        size_t pending = lr->end - lr->start;
+        if (make_room(lr) == -1) {
+            return -2;
+        }
+        scanned = lr->start + pending;
+
+        if (lr->wait_input != NULL) {
+            lr->wait_input(lr->fd);
+        }
+
+        // Keep one spare byte so an unterminated last line can still be NUL-terminated
+        ssize_t n = read(lr->fd, lr->buf + lr->end, lr->cap - lr->end - 1);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -2;
+        }
+        if (n == 0) {
+            lr->eof = 1;
+        }
+        lr->end += n;
+    }
+}
+
+/* Release the reader buffer (the descriptor is owned by the caller) */
+void line_reader_free(LineReader *lr) {
+    free(lr->buf);
+    lr->buf = NULL;
+    lr->cap = lr->start = lr->end = 0;
+}
+
+/* Register the shell's reader of stdin, NULL when commands come from elsewhere */
+void line_reader_set_stdin(LineReader *lr) {
+    stdin_reader = lr;
+}
+
+/* Reader that already owns stdin, so builtins reading stdin get the bytes it has buffered */
+LineReader *line_reader_stdin(void) {
+    return stdin_reader;
+}
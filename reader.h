@@ -0,0 +1,31 @@
+/*
+Author: Assem Samy
+File: reader.h
+Comment: Buffered line reader used by the shell main loop (stdin, script files and -c strings)
+*/
+
+#ifndef READER_H
+#define READER_H
+/*-----------------includes section--------------*/
+#include <stddef.h>
+#include <sys/types.h>
+/*----------------macros declarations-----------------*/
+#define READER_INITIAL_SIZE 65536
+/*-----------------types declarations-----------------*/
+typedef struct {
+    int fd;          // Source descriptor, -1 when reading from memory
+    char *buf;       // Holds unconsumed input, grows to fit the longest line
+    size_t cap;      // Allocated size of buf
+    size_t start;    // Offset of the first unconsumed byte
+    size_t end;      // Offset one past the last valid byte
+    int eof;         // Set once the source is exhausted
+    int (*wait_input)(int fd);  // Optional, called before each blocking read (job event loop)
+} LineReader;
+/*-----------section contains functions declarations------------*/
+int line_reader_init(LineReader *lr, int fd);
+int line_reader_init_mem(LineReader *lr, const char *text, size_t len);
+ssize_t line_reader_next(LineReader *lr, char **line);
+void line_reader_free(LineReader *lr);
+void line_reader_set_stdin(LineReader *lr);
+LineReader *line_reader_stdin(void);
+#endif
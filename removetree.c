@@ -0,0 +1,410 @@
+/*
+Author: Assem Samy
+File: removetree.c
+Comment: myrm -r, directories are read with getdents64 and emptied with unlinkat by work-stealing threads
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "removetree.h"
+#include "trace.h"
+#include "dirents.h"
+#include <pthread.h>
+
+/*-----------------types and static functions---------------*/
+
+/* A directory being emptied. It stays open until its last subdirectory is gone, then
+ * it is removed from its parent, which may in turn be ready to go.
+ */
+typedef struct RemoveNode {
+    struct RemoveNode *parent;   // NULL for a top-level operand
+    int fd;                      // The directory, base for unlinkat of its entries
+    char *name;                  // Name in the parent (the whole operand at the top)
+    char *path;                  // Only used in error messages
+    int refs;                    // The scan itself plus every queued or running subdirectory
+} RemoveNode;
+
+typedef struct {
+    RemoveNode *parent;
+    char *name;
+} RemoveTask;
+
+/* One per worker. The owner pushes and pops at the tail (depth first, few open
+ * directories), idle workers steal from the head, which holds the oldest and so
+ * usually the largest subtrees */
+typedef struct {
+    RemoveTask *tasks;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+    pthread_mutex_t lock;
+} TaskDeque;
+
+typedef struct {
+    TaskDeque *deques;
+    int workers;
+    long pending;                // Queued plus running tasks, 0 means the removal is over
+    long queued;                 // Tasks sitting in some deque
+    int sleepers;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    int force;
+    RemoveTreeStats *stats;
+    int failed;                  // errno of an allocation failure, queued tasks are then dropped
+} RemovePool;
+
+typedef struct {
+    RemovePool *pool;
+    int id;
+} RemoveWorker;
+
+static void report_error(RemovePool *pool, const RemoveNode *parent, const char *name, const char *what) {
+    int err = errno;
+    if (parent != NULL) {
+        fprintf(stderr, "myrm: %s/%s: %s: %s\n", parent->path, name, what, strerror(err));
+    } else {
+        fprintf(stderr, "myrm: %s: %s: %s\n", name, what, strerror(err));
+    }
+    __atomic_add_fetch(&pool->stats->errors, 1, __ATOMIC_RELAXED);
+}
+
+/* Stop the whole removal: it runs on worker threads, so an allocation failure is
+ * recorded here instead of exiting, and every worker drops what is still queued
+ */
+static void fail_pool(RemovePool *pool, int err) {
+    int none = 0;
+    __atomic_compare_exchange_n(&pool->failed, &none, err, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/* Queue a subdirectory, returns 0, or -1 once the removal is stopped */
+static int push_task(RemovePool *pool, int id, RemoveNode *parent, const char *name) {
+    TaskDeque *dq = &pool->deques[id];
+    char *copy = strdup(name);
+
+    if (copy == NULL) {
+        fail_pool(pool, ENOMEM);
+        return -1;
+    }
+    if (__atomic_load_n(&pool->failed, __ATOMIC_SEQ_CST) != 0) {
+        free(copy);
+        return -1;
+    }
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail == dq->capacity) {
+        if (dq->head > 0) {
+            // Reuse the room left by steals before growing
+            memmove(dq->tasks, dq->tasks + dq->head, (dq->tail - dq->head) * sizeof(RemoveTask));
+            dq->tail -= dq->head;
+            dq->head = 0;
+        }
+        if (dq->tail == dq->capacity) {
+            size_t new_capacity = dq->capacity ? dq->capacity * 2 : 64;
+            RemoveTask *tasks = realloc(dq->tasks, new_capacity * sizeof(RemoveTask));
+            if (tasks == NULL) {
+                pthread_mutex_unlock(&dq->lock);
+                free(copy);
+                fail_pool(pool, ENOMEM);
+                // Never queued. The caller's own task (or, for the operand, no worker yet) keeps this off 0
+                __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+                return -1;
+            }
+            dq->tasks = tasks;
+            dq->capacity = new_capacity;
+        }
+    }
+    RemoveTask *task = &dq->tasks[dq->tail++];
+    task->parent = parent;
+    task->name = copy;
+    pthread_mutex_unlock(&dq->lock);
+
+    // Wake a sleeper only if there is one, see wait_for_work()
+    __atomic_add_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->idle_lock);
+        pthread_cond_signal(&pool->idle_cond);
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+    return 0;
+}
+
+/* Own deque first (newest task), then the head of every other deque in turn */
+static int take_task(RemovePool *pool, int id, RemoveTask *out) {
+    for (int k = 0; k < pool->workers; k++) {
+        int victim = (id + k) % pool->workers;
+        TaskDeque *dq = &pool->deques[victim];
+        pthread_mutex_lock(&dq->lock);
+        if (dq->head == dq->tail) {
+            pthread_mutex_unlock(&dq->lock);
+            continue;
+        }
+        *out = (k == 0) ? dq->tasks[--dq->tail] : dq->tasks[dq->head++];
+        if (dq->head == dq->tail) {
+            dq->head = dq->tail = 0;
+        }
+        pthread_mutex_unlock(&dq->lock);
+        __atomic_sub_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+        if (k != 0) {
+            __atomic_add_fetch(&pool->stats->steals, 1, __ATOMIC_RELAXED);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/* Sleep until something is queued or everything is done. Returns 0 when done.
+ * The sleeper count is raised before 'queued' is checked and push_task() raises
+ * 'queued' before checking sleepers, so a push is never missed */
+static int wait_for_work(RemovePool *pool) {
+    int more = 1;
+    pthread_mutex_lock(&pool->idle_lock);
+    __atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0) {
+        if (__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) == 0) {
+            more = 0;
+            break;
+        }
+        pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+    }
+    __atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool->idle_lock);
+    return more;
+}
+
+/* Drop one reference, the last one removes the (now empty) directory from its parent.
+ * After a failure the directories are only closed, they are not empty.
+ */
+static void release_node(RemovePool *pool, RemoveNode *node) {
+    while (node != NULL && __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        RemoveNode *parent = node->parent;
+        close(node->fd);
+        if (__atomic_load_n(&pool->failed, __ATOMIC_SEQ_CST) == 0) {
+            if (unlinkat(parent != NULL ? parent->fd : AT_FDCWD, node->name, AT_REMOVEDIR) == -1) {
+                report_error(pool, NULL, node->path, "remove directory");
+            } else {
+                __atomic_add_fetch(&pool->stats->directories, 1, __ATOMIC_RELAXED);
+            }
+        }
+        free(node->name);
+        free(node->path);
+        free(node);
+        node = parent;
+    }
+}
+
+/* Open a directory, unlink everything in it but subdirectories, and queue those */
+static void empty_directory(RemovePool *pool, int id, RemoveNode *parent, const char *name) {
+    int parent_fd = parent != NULL ? parent->fd : AT_FDCWD;
+    int fd = openat(parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno == ENOTDIR || errno == ELOOP) {
+            // Replaced by a file or symlink since it was seen, remove it as one
+            if (unlinkat(parent_fd, name, 0) == 0) {
+                __atomic_add_fetch(&pool->stats->files, 1, __ATOMIC_RELAXED);
+                return;
+            }
+        }
+        if (!(pool->force && errno == ENOENT)) {
+            report_error(pool, parent, name, "open directory");
+        }
+        return;
+    }
+
+    RemoveNode *node = calloc(1, sizeof(RemoveNode));
+    char *buffer = malloc(REMOVE_TREE_DENTS_SIZE);
+    if (node != NULL) {
+        node->name = strdup(name);
+        if (parent != NULL) {
+            node->path = malloc(strlen(parent->path) + strlen(name) + 2);
+            if (node->path != NULL) {
+                sprintf(node->path, "%s/%s", parent->path, name);
+            }
+        } else {
+            node->path = strdup(name);
+        }
+    }
+    if (node == NULL || buffer == NULL || node->name == NULL || node->path == NULL) {
+        fail_pool(pool, ENOMEM);
+        if (node != NULL) {
+            free(node->name);
+            free(node->path);
+        }
+        free(node);
+        free(buffer);
+        close(fd);
+        return;
+    }
+    node->parent = parent;
+    node->fd = fd;
+    node->refs = 1;
+    if (parent != NULL) {
+        __atomic_add_fetch(&parent->refs, 1, __ATOMIC_RELAXED);
+    }
+
+    // getdents64 straight into a big buffer: no DIR* and no stat, d_type says what each entry is
+    long n;
+    int stopped = 0;
+    while (!stopped && (n = dirents_read(fd, buffer, REMOVE_TREE_DENTS_SIZE)) > 0) {
+        for (long offset = 0; offset < n;) {
+            struct linux_dirent64 *entry = (struct linux_dirent64 *)(buffer + offset);
+            offset += entry->d_reclen;
+            const char *entry_name = entry->d_name;
+            if (dirents_is_dot(entry_name)) {
+                continue;
+            }
+            if (entry->d_type == DT_DIR) {
+                __atomic_add_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+                if (push_task(pool, id, node, entry_name) == -1) {
+                    __atomic_sub_fetch(&node->refs, 1, __ATOMIC_RELAXED);   // Still held by the scan
+                    stopped = 1;
+                    break;
+                }
+                continue;
+            }
+            if (unlinkat(fd, entry_name, 0) == 0) {
+                __atomic_add_fetch(&pool->stats->files, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+            // DT_UNKNOWN on some file systems: unlink refuses directories with EISDIR (EPERM on older kernels)
+            struct stat st;
+            if ((errno == EISDIR || errno == EPERM) && entry->d_type == DT_UNKNOWN &&
+                fstatat(fd, entry_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode)) {
+                __atomic_add_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+                if (push_task(pool, id, node, entry_name) == -1) {
+                    __atomic_sub_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+                    stopped = 1;
+                    break;
+                }
+            } else if (!(pool->force && errno == ENOENT)) {
+                report_error(pool, node, entry_name, "remove");
+            }
+        }
+    }
+    if (n == -1) {
+        report_error(pool, parent, name, "read directory");
+    }
+    free(buffer);
+    release_node(pool, node);
+}
+
+static void *remove_worker(void *arg) {
+    RemoveWorker *worker = arg;
+    RemovePool *pool = worker->pool;
+    RemoveTask task;
+
+    while (1) {
+        if (!take_task(pool, worker->id, &task)) {
+            if (!wait_for_work(pool)) {
+                break;
+            }
+            continue;
+        }
+        if (__atomic_load_n(&pool->failed, __ATOMIC_SEQ_CST) == 0) {
+            empty_directory(pool, worker->id, task.parent, task.name);
+        }
+        if (task.parent != NULL) {
+            release_node(pool, task.parent);
+        }
+        free(task.name);
+
+        if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+            // The last task is done, wake everyone so they can leave
+            pthread_mutex_lock(&pool->idle_lock);
+            pthread_cond_broadcast(&pool->idle_cond);
+            pthread_mutex_unlock(&pool->idle_lock);
+        }
+    }
+    return NULL;
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Remove 'path' and everything below it, like rm -r. Each worker empties one directory
+ * at a time with getdents64 and unlinkat relative to the directory's fd, queues the
+ * subdirectories on its own deque, and steals from the other workers when it runs
+ * dry, so one deep subtree does not leave the rest of the pool idle. A directory is
+ * removed as soon as its last subdirectory is. Failing entries are reported on stderr
+ * and the rest of the tree is still removed; with 'force' missing entries are not errors.
+ * An allocation failure stops the whole removal and leaves its errno in stats->failed.
+ * Returns 0, or -1 if anything failed; counts are added to 'stats'.
+ */
+int remove_tree(const char *path, int force, RemoveTreeStats *stats) {
+    long errors_before = stats->errors;
+    struct stat st;
+
+    if (lstat(path, &st) == -1) {
+        if (force && errno == ENOENT) {
+            return 0;
+        }
+        fprintf(stderr, "myrm: %s: %s\n", path, strerror(errno));
+        stats->errors++;
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        if (unlink(path) == -1) {
+            fprintf(stderr, "myrm: %s: %s\n", path, strerror(errno));
+            stats->errors++;
+            return -1;
+        }
+        stats->files++;
+        return 0;
+    }
+
+    int workers = get_nprocs();
+    if (workers < REMOVE_TREE_MIN_WORKERS) {
+        workers = REMOVE_TREE_MIN_WORKERS;
+    }
+    RemovePool pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.deques = calloc(workers, sizeof(TaskDeque));
+    if (pool.deques == NULL) {
+        stats->failed = ENOMEM;
+        return -1;
+    }
+    for (int k = 0; k < workers; k++) {
+        pthread_mutex_init(&pool.deques[k].lock, NULL);
+    }
+    pool.workers = workers;
+    pool.force = force;
+    pool.stats = stats;
+    pthread_mutex_init(&pool.idle_lock, NULL);
+    pthread_cond_init(&pool.idle_cond, NULL);
+
+    // The operand is a task like any other, with the whole path as its name. If it cannot
+    // be queued the workers find nothing to do and leave at once
+    push_task(&pool, 0, NULL, path);
+
+    pthread_t threads[workers];
+    RemoveWorker args[workers];
+    int started = 0;
+    for (int k = 0; k < workers; k++) {
+        args[k].pool = &pool;
+        args[k].id = k;
+        if (pthread_create(&threads[k], NULL, remove_worker, &args[k]) != 0) {
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        remove_worker(&args[0]);  // No threads available, remove on this one
+    }
+    for (int k = 0; k < started; k++) {
+        pthread_join(threads[k], NULL);
+    }
+
+    TRACE(TRACE_INFO, "Removed tree %s: %ld files, %ld directories, %ld errors, %ld steals, %d workers",
+          path, stats->files, stats->directories, stats->errors - errors_before, stats->steals, started);
+
+    for (int k = 0; k < workers; k++) {
+        pthread_mutex_destroy(&pool.deques[k].lock);
+        free(pool.deques[k].tasks);
+    }
+    free(pool.deques);
+    pthread_mutex_destroy(&pool.idle_lock);
+    pthread_cond_destroy(&pool.idle_cond);
+    if (pool.failed != 0) {
+        stats->failed = pool.failed;
+        return -1;
+    }
+    return stats->errors > errors_before ? -1 : 0;
+}
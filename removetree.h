@@ -0,0 +1,24 @@
+/*
+Author: Assem Samy
+File: removetree.h
+Comment: myrm -r, removes directory trees with a pool of work-stealing threads working on directory descriptors
+*/
+
+#ifndef REMOVETREE_H
+#define REMOVETREE_H
+/*-----------------includes section--------------*/
+#include <sys/types.h>
+/*----------------macros declarations-----------------*/
+#define REMOVE_TREE_MIN_WORKERS 4          // Unlinks wait on the journal, so use at least this many threads
+#define REMOVE_TREE_DENTS_SIZE  (64 * 1024) // getdents64 buffer, a few thousand names per call
+/*-----------------types declarations-----------------*/
+typedef struct {
+    long files;        // Everything but directories
+    long directories;
+    long errors;       // Entries that could not be removed, each one reported on stderr
+    long steals;       // Directories a worker took from another worker's queue
+    int failed;        // errno of a failure that stopped the removal (out of memory), 0 if none
+} RemoveTreeStats;
+/*-----------section contains functions declarations------------*/
+int remove_tree(const char *path, int force, RemoveTreeStats *stats);
+#endif
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Author: Assem Samy
+# File: tests/mymv_slash.sh
+# Comment: mymv must ignore trailing slashes on the source, as mv does: "src/" moves src into the
+#          destination directory, with and without -f, and never replaces the destination itself.
+# Usage: sh tests/mymv_slash.sh [shell binary]     (default: ./shell.out, run from the repository root)
+
+shell=$(realpath "${1:-./shell.out}") || exit 1
+work=$(mktemp -d /tmp/mymv_slash.XXXXXX) || exit 1
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+status=0
+for flag in "" "-f "; do
+    rm -rf src dst
+    mkdir -p src dst && echo data > src/file
+    printf 'mymv %ssrc/ dst\n' "$flag" | "$shell" > output 2>&1
+    if [ -f dst/src/file ] && [ ! -e src ]; then
+        echo "ok: mymv ${flag}src/ dst moved src into dst"
+    else
+        echo "FAIL: mymv ${flag}src/ dst did not move src into dst"
+        cat output
+        status=1
+    fi
+done
+exit $status
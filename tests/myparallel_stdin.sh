@@ -0,0 +1,22 @@
+#!/bin/sh
+# Author: Assem Samy
+# File: tests/myparallel_stdin.sh
+# Comment: In a piped script, myparallel takes the rest of the script as its items. More than the
+#          reader's first 64 KB (READER_INITIAL_SIZE) of items makes the reader move its buffer, which
+#          must not touch the command template taken from the same buffer.
+# Usage: sh tests/myparallel_stdin.sh [shell binary]     (default: ./shell.out, run from the repository root)
+
+shell=${1:-./shell.out}
+items=20000   # 108 KB of "1\n" ... "20000\n"
+
+output=$({ echo "myparallel -k -n 100000 echo HELLO"; seq 1 $items; } | "$shell" 2>&1)
+if echo "$output" | grep -q "command not found"; then
+    echo "FAIL: items were run as commands"
+    exit 1
+fi
+line=$(echo "$output" | grep "^HELLO ")
+if [ "$(echo "$line" | wc -w)" -ne $((items + 1)) ] || [ "${line##* }" != "$items" ]; then
+    echo "FAIL: echo HELLO did not get all $items items"
+    exit 1
+fi
+echo "ok: myparallel read $items items from the piped script"
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Author: Assem Samy
+# File: tests/myrm_root.sh
+# Comment: myrm must refuse the root however it is spelled, and any path ending in . or .. (trailing
+#          slashes included). Runs under tests/no_unlink.c, so even a broken guard removes nothing:
+#          the test fails if any removal is attempted.
+# Usage: sh tests/myrm_root.sh [shell binary]     (default: ./shell.out, run from the repository root)
+
+shell=$(realpath "${1:-./shell.out}") || exit 1
+guard=$(mktemp /tmp/no_unlink.XXXXXX.so) || exit 1
+work=$(mktemp -d /tmp/myrm_root.XXXXXX) || exit 1
+trap 'rm -rf "$guard" "$work"' EXIT
+gcc -shared -fPIC tests/no_unlink.c -o "$guard" || exit 1
+
+# The relative operands are resolved in a scratch directory with a subdirectory 'a'
+mkdir "$work/a" && cd "$work" || exit 1
+
+status=0
+for operand in / // /// /./ /../ . .. ./ ../ a/. a/.. a/..//; do
+    output=$(printf 'myrm -r %s\nmyrm -rf %s\n' "$operand" "$operand" | LD_PRELOAD="$guard" "$shell" 2>&1)
+    if echo "$output" | grep -q "no_unlink:"; then
+        echo "FAIL: myrm -r $operand tried to remove something"
+        status=1
+    elif [ "$(echo "$output" | grep -cF "refusing to remove '$operand'")" -ne 2 ]; then
+        echo "FAIL: myrm -r $operand was not refused"
+        status=1
+    else
+        echo "ok: myrm -r $operand refused"
+    fi
+done
+exit $status
@@ -0,0 +1,29 @@
+/*
+Author: Assem Samy
+File: tests/no_unlink.c
+Comment: LD_PRELOAD guard for tests that must remove nothing: unlink, unlinkat and rmdir are logged and refused
+Build: gcc -shared -fPIC tests/no_unlink.c -o no_unlink.so
+*/
+
+/*-----------------Includes Section--------------*/
+#include <errno.h>
+#include <stdio.h>
+
+/*-----------Section Contains Function Definitions------------*/
+int unlink(const char *path) {
+    fprintf(stderr, "no_unlink: unlink(%s) refused\n", path);
+    errno = EPERM;
+    return -1;
+}
+
+int unlinkat(int dir_fd, const char *path, int flags) {
+    fprintf(stderr, "no_unlink: unlinkat(%d, %s, %d) refused\n", dir_fd, path, flags);
+    errno = EPERM;
+    return -1;
+}
+
+int rmdir(const char *path) {
+    fprintf(stderr, "no_unlink: rmdir(%s) refused\n", path);
+    errno = EPERM;
+    return -1;
+}
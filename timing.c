@@ -0,0 +1,302 @@
+/*
+Author: Assem Samy
+File: timing.c
+Comment: mytime, runs a command line through the normal launch path and reports the rusage wait4 collected
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "timing.h"
+#include "builtins.h"
+#include "pipeline.h"
+#include "trace.h"
+#include <stdint.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+/*-----------------types and static functions---------------*/
+typedef struct {
+    double real;          // Sums over every run, divided by the run count when printed
+    double user;
+    double sys;
+    long maxrss;          // Largest seen, in KB
+    long majflt;
+    long minflt;
+    long nvcsw;
+    long nivcsw;
+} TimingTotals;
+
+/* HDR-style histogram: values below TIMING_HIST_SUB_COUNT get their own bucket,
+ * above that every power of two is split in TIMING_HIST_SUB_COUNT equal buckets,
+ * so the relative error stays the same from microseconds to minutes.
+ */
+typedef struct {
+    unsigned long counts[TIMING_HIST_BUCKETS];
+} TimingHistogram;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double timeval_seconds(const struct timeval *tv) {
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static void totals_add(TimingTotals *t, double real, const struct rusage *ru) {
+    t->real += real;
+    t->user += timeval_seconds(&ru->ru_utime);
+    t->sys += timeval_seconds(&ru->ru_stime);
+    if (ru->ru_maxrss > t->maxrss) {
+        t->maxrss = ru->ru_maxrss;
+    }
+    t->majflt += ru->ru_majflt;
+    t->minflt += ru->ru_minflt;
+    t->nvcsw += ru->ru_nvcsw;
+    t->nivcsw += ru->ru_nivcsw;
+}
+
+/* Usage of a builtin: what the shell itself used while it ran */
+static void rusage_delta(struct rusage *out, const struct rusage *before, const struct rusage *after) {
+    timersub(&after->ru_utime, &before->ru_utime, &out->ru_utime);
+    timersub(&after->ru_stime, &before->ru_stime, &out->ru_stime);
+    out->ru_maxrss = after->ru_maxrss;  // A high-water mark, not a counter
+    out->ru_majflt = after->ru_majflt - before->ru_majflt;
+    out->ru_minflt = after->ru_minflt - before->ru_minflt;
+    out->ru_nvcsw = after->ru_nvcsw - before->ru_nvcsw;
+    out->ru_nivcsw = after->ru_nivcsw - before->ru_nivcsw;
+}
+
+static int histogram_index(uint64_t value) {
+    if (value < TIMING_HIST_SUB_COUNT) {
+        return (int)value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int sub = (value >> (exponent - TIMING_HIST_SUB_BITS)) & (TIMING_HIST_SUB_COUNT - 1);
+    return (exponent - TIMING_HIST_SUB_BITS + 1) * TIMING_HIST_SUB_COUNT + sub;
+}
+
+/* Smallest value that falls in bucket 'index' */
+static uint64_t histogram_lower(int index) {
+    if (index < TIMING_HIST_SUB_COUNT) {
+        return index;
+    }
+    int exponent = index / TIMING_HIST_SUB_COUNT + TIMING_HIST_SUB_BITS - 1;
+    uint64_t sub = index % TIMING_HIST_SUB_COUNT;
+    return (TIMING_HIST_SUB_COUNT + sub) << (exponent - TIMING_HIST_SUB_BITS);
+}
+
+static void histogram_print(const TimingHistogram *h) {
+    int first = -1;
+    int last = -1;
+    unsigned long widest = 0;
+
+    for (int k = 0; k < TIMING_HIST_BUCKETS; k++) {
+        if (h->counts[k] == 0) {
+            continue;
+        }
+        if (first == -1) {
+            first = k;
+        }
+        last = k;
+        if (h->counts[k] > widest) {
+            widest = h->counts[k];
+        }
+    }
+    if (first == -1) {
+        return;
+    }
+
+    fprintf(stderr, "histogram (ms):\n");
+    for (int k = first; k <= last; k++) {
+        int bar = (int)(h->counts[k] * TIMING_HIST_BAR_WIDTH / widest);
+        if (bar == 0 && h->counts[k] > 0) {
+            bar = 1;
+        }
+        fprintf(stderr, "  %10.3f - %10.3f | %-*.*s %lu\n",
+                histogram_lower(k) / 1e3, histogram_lower(k + 1) / 1e3,
+                TIMING_HIST_BAR_WIDTH, bar,
+                "########################################", h->counts[k]);
+    }
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of 'count' sorted samples */
+static double percentile(const double *sorted, int count, double p) {
+    int rank = (int)(p / 100.0 * count + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank > count) {
+        rank = count;
+    }
+    return sorted[rank - 1];
+}
+
+static void print_header(void) {
+    fprintf(stderr, "%-6s %6s %10s %10s %10s %10s %7s %8s %7s %7s  %s\n",
+            "stage", "status", "real", "user", "sys", "maxrss_kb",
+            "majflt", "minflt", "vcsw", "ivcsw", "command");
+}
+
+/* One row of averages, 'label' is the stage number or "total" */
+static void print_row(const char *label, const char *status, const TimingTotals *t, int runs, const char *command) {
+    fprintf(stderr, "%-6s %6s %10.4f %10.4f %10.4f %10ld %7ld %8ld %7ld %7ld  %s\n",
+            label, status, t->real / runs, t->user / runs, t->sys / runs, t->maxrss,
+            t->majflt / runs, t->minflt / runs, t->nvcsw / runs, t->nivcsw / runs, command);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: mytime [-r runs] command [args...] [| command ...]\n");
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* mytime [-r runs] <command line>: tokens [from, to) start with the word mytime.
+ * The rest of the segment may be a builtin, a command or a whole pipeline with
+ * redirections. External commands run through pipeline_run, whose wait4 reaping
+ * fills each stage's rusage; builtins are measured with getrusage(RUSAGE_SELF).
+ * The report goes to stderr: one row per stage (averages with -r) and, with -r,
+ * min/mean/max, p50/p95/p99 of the wall time and a histogram.
+ * Returns the status of the last run.
+ */
+int time_segment(TokenList *tl, size_t from, size_t to) {
+    size_t k = from + 1;
+    int runs = 1;
+
+    while (k < to && tl->tokens[k].kind == TOKEN_WORD && tl->tokens[k].start[0] == '-') {
+        const char *opt = tl->tokens[k].start;
+        if (strcmp(opt, "--") == 0) {
+            k++;
+            break;
+        }
+        if (strcmp(opt, "-r") != 0 || k + 1 >= to || (runs = atoi(tl->tokens[k + 1].start)) <= 0) {
+            usage();
+            return 1;
+        }
+        k += 2;
+    }
+    if (k >= to || tl->tokens[k].kind != TOKEN_WORD) {
+        usage();
+        return 1;
+    }
+
+    int operator_found = 0;
+    for (size_t m = k; m < to; m++) {
+        if (tl->tokens[m].kind != TOKEN_WORD) {
+            operator_found = 1;
+        }
+    }
+
+    const Builtin *builtin = operator_found ? NULL : builtin_lookup(tl->tokens[k].start);
+    PipelineStage *stages = NULL;
+    char **words = NULL;
+    int stage_count = 1;
+
+    if (builtin != NULL) {
+        words = token_list_strings(tl, k, to);
+        if (words == NULL) {
+            return 1;
+        }
+    } else {
+        stage_count = pipeline_parse(tl, k, to, &stages);
+        if (stage_count <= 0) {
+            return 1;
+        }
+    }
+
+    double *samples = malloc(runs * sizeof(double));
+    TimingTotals *totals = calloc(stage_count + 1, sizeof(TimingTotals));  // Last one is the whole line
+    TimingHistogram *hist = calloc(1, sizeof(TimingHistogram));
+    int *last_status = calloc(stage_count, sizeof(int));
+    if (samples == NULL || totals == NULL || hist == NULL || last_status == NULL) {
+        perror("malloc failed");
+        free(samples);
+        free(totals);
+        free(hist);
+        free(last_status);
+        return 1;
+    }
+
+    int status = 0;
+    for (int r = 0; r < runs; r++) {
+        struct rusage before, after, delta;
+        double start = now_seconds();
+
+        if (builtin != NULL) {
+            getrusage(RUSAGE_SELF, &before);
+            if (builtin->segment_handler != NULL) {
+                status = builtin->segment_handler(tl, k, to);
+            } else {
+                status = builtin->handler(to - k, words);
+            }
+            getrusage(RUSAGE_SELF, &after);
+            fflush(stdout);
+        } else {
+            status = pipeline_run(stages, stage_count, 0);
+        }
+        double real = now_seconds() - start;
+
+        samples[r] = real;
+        hist->counts[histogram_index((uint64_t)(real * 1e6))]++;
+        if (builtin != NULL) {
+            rusage_delta(&delta, &before, &after);
+            totals_add(&totals[0], real, &delta);
+            last_status[0] = status;
+            totals_add(&totals[stage_count], real, &delta);
+        } else {
+            struct rusage sum;
+            memset(&sum, 0, sizeof(sum));
+            for (int s = 0; s < stage_count; s++) {
+                const struct rusage *ru = &stages[s].usage;
+                totals_add(&totals[s], stages[s].elapsed, ru);
+                last_status[s] = stages[s].status;
+                timeradd(&sum.ru_utime, &ru->ru_utime, &sum.ru_utime);
+                timeradd(&sum.ru_stime, &ru->ru_stime, &sum.ru_stime);
+                if (ru->ru_maxrss > sum.ru_maxrss) {
+                    sum.ru_maxrss = ru->ru_maxrss;
+                }
+                sum.ru_majflt += ru->ru_majflt;
+                sum.ru_minflt += ru->ru_minflt;
+                sum.ru_nvcsw += ru->ru_nvcsw;
+                sum.ru_nivcsw += ru->ru_nivcsw;
+            }
+            totals_add(&totals[stage_count], real, &sum);
+        }
+        TRACE(TRACE_DEBUG, "mytime run %d: %.6f s, status %d", r + 1, real, status);
+    }
+
+    print_header();
+    for (int s = 0; s < stage_count; s++) {
+        char label[16];
+        char code[16];
+        snprintf(label, sizeof(label), "%d", s + 1);
+        snprintf(code, sizeof(code), "%d", last_status[s]);
+        print_row(label, code, &totals[s], runs, builtin != NULL ? words[0] : stages[s].argv[0]);
+    }
+    if (stage_count > 1) {
+        print_row("total", "", &totals[stage_count], runs, "");
+    }
+
+    if (runs > 1) {
+        qsort(samples, runs, sizeof(double), compare_doubles);
+        fprintf(stderr, "runs %d  min %.3f ms  mean %.3f ms  max %.3f ms\n",
+                runs, samples[0] * 1e3, totals[stage_count].real / runs * 1e3, samples[runs - 1] * 1e3);
+        fprintf(stderr, "p50 %.3f ms  p95 %.3f ms  p99 %.3f ms\n",
+                percentile(samples, runs, 50) * 1e3, percentile(samples, runs, 95) * 1e3,
+                percentile(samples, runs, 99) * 1e3);
+        histogram_print(hist);
+    }
+
+    free(samples);
+    free(totals);
+    free(hist);
+    free(last_status);
+    return status;
+}
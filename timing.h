@@ -0,0 +1,19 @@
+/*
+Author: Assem Samy
+File: timing.h
+Comment: mytime, wall time and rusage of a command or pipeline, with latency percentiles over repeated runs
+*/
+
+#ifndef TIMING_H
+#define TIMING_H
+/*-----------------includes section--------------*/
+#include <stddef.h>
+#include "tokenizer.h"
+/*----------------macros declarations-----------------*/
+#define TIMING_HIST_SUB_BITS 4                               // 16 sub-buckets per power of two, about 6% precision
+#define TIMING_HIST_SUB_COUNT (1 << TIMING_HIST_SUB_BITS)
+#define TIMING_HIST_BUCKETS ((64 - TIMING_HIST_SUB_BITS + 1) * TIMING_HIST_SUB_COUNT)
+#define TIMING_HIST_BAR_WIDTH 40                             // Columns of the widest histogram bar
+/*-----------section contains functions declarations------------*/
+int time_segment(TokenList *tl, size_t from, size_t to);
+#endif
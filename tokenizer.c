@@ -0,0 +1,211 @@
+/*
+Author: Assem Samy
+File: tokenizer.c
+Comment: Splits a command line in place, handling quotes, escapes and the | < > 2> & operators
+*/
+
+/*-----------------Includes Section--------------*/
+#include "tokenizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*-----------------variables and static functions---------------*/
+static char pipe_text[] = "|";
+static char in_text[] = "<";
+static char out_text[] = ">";
+static char err_text[] = "2>";
+static char background_text[] = "&";
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* Return the TOKEN_* kind of a one-character operator, or TOKEN_WORD if 'c' is not one */
+static int operator_kind(char c) {
+    switch (c) {
+        case '|': return TOKEN_PIPE;
+        case '<': return TOKEN_REDIR_IN;
+        case '>': return TOKEN_REDIR_OUT;
+        case '&': return TOKEN_BACKGROUND;
+        default:  return TOKEN_WORD;
+    }
+}
+
+static int push_token(TokenList *tl, char *start, size_t len, int kind) {
+    if (tl->count >= tl->capacity) {
+        size_t new_capacity = tl->capacity ? tl->capacity * 2 : TOKEN_LIST_INITIAL_CAPACITY;
+        Token *new_tokens = realloc(tl->tokens, new_capacity * sizeof(Token));
+        if (new_tokens == NULL) {
+            perror("realloc failed");
+            return -1;
+        }
+        tl->tokens = new_tokens;
+        tl->capacity = new_capacity;
+    }
+    tl->tokens[tl->count].start = start;
+    tl->tokens[tl->count].len = len;
+    tl->tokens[tl->count].kind = kind;
+    tl->count++;
+    return 0;
+}
+
+static int push_operator(TokenList *tl, int kind) {
+    switch (kind) {
+        case TOKEN_PIPE:      return push_token(tl, pipe_text, 1, kind);
+        case TOKEN_REDIR_IN:  return push_token(tl, in_text, 1, kind);
+        case TOKEN_REDIR_OUT: return push_token(tl, out_text, 1, kind);
+        case TOKEN_BACKGROUND: return push_token(tl, background_text, 1, kind);
+        default:              return push_token(tl, err_text, 2, kind);
+    }
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+void token_list_init(TokenList *tl) {
+    tl->tokens = NULL;
+    tl->count = 0;
+    tl->capacity = 0;
+    arena_init(&tl->arena);
+}
+
+/* Tokenize 'line' (NUL-terminated, 'len' bytes) in place.
+ * Quote removal and escapes only ever shrink a word, so every word is rewritten
+ * inside its own span and terminated there: no token text is copied out of the line.
+ * Returns the number of tokens, or -1 on a syntax error (unterminated quote).
+ */
+int tokenize_line(TokenList *tl, char *line, size_t len) {
+    size_t r = 0;  // Read position
+    size_t w;      // Write position, never ahead of r
+
+    tl->count = 0;
+    arena_reset(&tl->arena);
+
+    while (1) {
+        while (r < len && is_blank(line[r])) {
+            r++;
+        }
+        if (r >= len) {
+            break;
+        }
+
+        int kind = operator_kind(line[r]);
+        if (kind != TOKEN_WORD) {
+            if (push_operator(tl, kind) == -1) {
+                return -1;
+            }
+            r++;
+            continue;
+        }
+        if (line[r] == '2' && r + 1 < len && line[r + 1] == '>') {
+            if (push_operator(tl, TOKEN_REDIR_ERR) == -1) {
+                return -1;
+            }
+            r += 2;
+            continue;
+        }
+
+        // Word: copy characters down to 'w', dropping quotes and escape backslashes
+        w = r;
+        char *start = line + w;
+        while (r < len && !is_blank(line[r]) && operator_kind(line[r]) == TOKEN_WORD) {
+            char c = line[r];
+            if (c == '\\') {
+                r++;
+                if (r < len) {
+                    line[w++] = line[r++];
+                }
+            } else if (c == '\'') {
+                r++;
+                while (r < len && line[r] != '\'') {
+                    line[w++] = line[r++];
+                }
+                if (r >= len) {
+                    fprintf(stderr, "syntax error: unterminated quote\n");
+                    return -1;
+                }
+                r++;
+            } else if (c == '"') {
+                r++;
+                while (r < len && line[r] != '"') {
+                    if (line[r] == '\\' && r + 1 < len && strchr("\"\\$`", line[r + 1]) != NULL) {
+                        r++;
+                    }
+                    line[w++] = line[r++];
+                }
+                if (r >= len) {
+                    fprintf(stderr, "syntax error: unterminated quote\n");
+                    return -1;
+                }
+                r++;
+            } else {
+                line[w++] = line[r++];
+            }
+        }
+
+        // The terminator may land on the character that ended the word, so look at it first
+        int next_kind = (r < len) ? operator_kind(line[r]) : TOKEN_WORD;
+        line[w] = '\0';
+        if (push_token(tl, start, w - (start - line), TOKEN_WORD) == -1) {
+            return -1;
+        }
+        if (next_kind != TOKEN_WORD) {
+            if (push_operator(tl, next_kind) == -1) {
+                return -1;
+            }
+        }
+        if (r < len) {
+            r++;
+        }
+    }
+    return (int)tl->count;
+}
+
+/* Return the text of tokens [from, to) as a NULL-terminated array, operators included */
+char **token_list_strings(TokenList *tl, size_t from, size_t to) {
+    char **strings = arena_alloc(&tl->arena, (to - from + 1) * sizeof(char *));
+    if (strings == NULL) {
+        perror("malloc failed");
+        return NULL;
+    }
+    for (size_t i = from; i < to; i++) {
+        strings[i - from] = tl->tokens[i].start;
+    }
+    strings[to - from] = NULL;
+    return strings;
+}
+
+/* Build an execvp-ready argv from tokens [from, to).
+ * Redirection operators and their file names are left out, the strings are not copied.
+ */
+char **token_list_argv(TokenList *tl, size_t from, size_t to, int *argc) {
+    char **argv = arena_alloc(&tl->arena, (to - from + 1) * sizeof(char *));
+    int n = 0;
+    if (argv == NULL) {
+        perror("malloc failed");
+        return NULL;
+    }
+    for (size_t i = from; i < to; i++) {
+        if (token_is_redirection(&tl->tokens[i])) {
+            i++;  // Skip the file name as well
+        } else if (tl->tokens[i].kind == TOKEN_WORD) {
+            argv[n++] = tl->tokens[i].start;
+        }
+    }
+    argv[n] = NULL;
+    if (argc != NULL) {
+        *argc = n;
+    }
+    return argv;
+}
+
+int token_is_redirection(const Token *tok) {
+    return tok->kind == TOKEN_REDIR_IN || tok->kind == TOKEN_REDIR_OUT || tok->kind == TOKEN_REDIR_ERR;
+}
+
+void token_list_free(TokenList *tl) {
+    free(tl->tokens);
+    tl->tokens = NULL;
+    tl->count = tl->capacity = 0;
+    arena_free(&tl->arena);
+}
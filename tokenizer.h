@@ -0,0 +1,40 @@
+/*
+Author: Assem Samy
+File: tokenizer.h
+Comment: Zero-copy command line tokenizer, tokens are (pointer, length) spans into the line itself
+*/
+
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+/*-----------------includes section--------------*/
+#include <stddef.h>
+#include "arena.h"
+/*----------------macros declarations-----------------*/
+#define TOKEN_WORD       0
+#define TOKEN_PIPE       1   // |
+#define TOKEN_REDIR_IN   2   // <
+#define TOKEN_REDIR_OUT  3   // >
+#define TOKEN_REDIR_ERR  4   // 2>
+#define TOKEN_BACKGROUND 5   // &
+#define TOKEN_LIST_INITIAL_CAPACITY 64
+/*-----------------types declarations-----------------*/
+typedef struct {
+    char *start;   // NUL-terminated text, points into the tokenized line (or a static operator string)
+    size_t len;    // Length of the text without the terminator
+    int kind;      // One of the TOKEN_* values
+} Token;
+
+typedef struct {
+    Token *tokens;   // Reused from line to line, grows on demand
+    size_t count;
+    size_t capacity;
+    Arena arena;     // Per-line storage for argv vectors, reset by every tokenize_line
+} TokenList;
+/*-----------section contains functions declarations------------*/
+void token_list_init(TokenList *tl);
+int tokenize_line(TokenList *tl, char *line, size_t len);
+char **token_list_strings(TokenList *tl, size_t from, size_t to);
+char **token_list_argv(TokenList *tl, size_t from, size_t to, int *argc);
+int token_is_redirection(const Token *tok);
+void token_list_free(TokenList *tl);
+#endif
@@ -0,0 +1,175 @@
+/*
+Author: Assem Samy
+File: trace.c
+Comment: Lock-free trace ring buffer, dumped on demand (mytrace dump) or when the shell crashes
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "trace.h"
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+
+/*-----------------variables and static functions---------------*/
+typedef struct {
+    _Atomic unsigned long seq;   // Event number + 1 once the slot is complete, 0 while being written
+    struct timespec time;
+    int level;
+    char msg[TRACE_MSG_SIZE];
+} TraceSlot;
+
+int trace_level = TRACE_OFF;
+
+static TraceSlot ring[TRACE_RING_SIZE];
+static _Atomic unsigned long ring_head = 0;   // Number of events ever recorded
+static char crash_file[PATH_MAX];
+
+static const char *level_names[] = {"off", "error", "info", "debug"};
+
+/* Append the decimal form of 'value' to 'out', zero padded to 'width' (async-signal-safe) */
+static size_t format_ulong(char *out, unsigned long value, int width) {
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (n < width) {
+        digits[n++] = '0';
+    }
+    for (int k = 0; k < n; k++) {
+        out[k] = digits[n - 1 - k];
+    }
+    return n;
+}
+
+/* Write the events still in the ring as "[seconds.micros] level message" lines.
+ * Only uses write(), so it is safe to call from the crash handler.
+ */
+static int dump_ring(int fd) {
+    char line[TRACE_MSG_SIZE + 64];
+    unsigned long head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    unsigned long first = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+    int written = 0;
+
+    for (unsigned long idx = first; idx < head; idx++) {
+        TraceSlot *slot = &ring[idx & (TRACE_RING_SIZE - 1)];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != idx + 1) {
+            continue;  // Overwritten or still being written
+        }
+
+        size_t len = 0;
+        line[len++] = '[';
+        len += format_ulong(line + len, slot->time.tv_sec, 1);
+        line[len++] = '.';
+        len += format_ulong(line + len, slot->time.tv_nsec / 1000, 6);
+        line[len++] = ']';
+        line[len++] = ' ';
+        const char *name = level_names[slot->level];
+        while (*name) {
+            line[len++] = *name++;
+        }
+        line[len++] = ' ';
+        for (const char *m = slot->msg; *m; m++) {
+            line[len++] = *m;
+        }
+        line[len++] = '\n';
+
+        if (write(fd, line, len) != (ssize_t)len) {
+            return -1;
+        }
+        written++;
+    }
+    return written;
+}
+
+static void crash_handler(int sig) {
+    int fd = open(crash_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd != -1) {
+        dump_ring(fd);
+        close(fd);
+    }
+    // SA_RESETHAND restored the default action, let the signal finish the job
+    raise(sig);
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Read the runtime level from $SHELL_TRACE and install the crash dump handler.
+ * The crash dump goes to $SHELL_TRACE_FILE, or /tmp/shell_trace.<pid>.
+ */
+void trace_init(void) {
+    const char *level = getenv("SHELL_TRACE");
+    if (level != NULL && trace_level_from_name(level) != -1) {
+        trace_level = trace_level_from_name(level);
+    }
+
+    const char *file = getenv("SHELL_TRACE_FILE");
+    if (file != NULL) {
+        snprintf(crash_file, sizeof(crash_file), "%s", file);
+    } else {
+        snprintf(crash_file, sizeof(crash_file), "/tmp/shell_trace.%d", (int)getpid());
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = crash_handler;
+    sa.sa_flags = SA_RESETHAND;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, NULL);
+    sigaction(SIGBUS, &sa, NULL);
+    sigaction(SIGFPE, &sa, NULL);
+    sigaction(SIGILL, &sa, NULL);
+    sigaction(SIGABRT, &sa, NULL);
+}
+
+/* Record one event. Writers claim a slot with a single atomic increment, so any
+ * thread can trace without locks; the slot's sequence number publishes it to readers.
+ */
+void trace_event(int level, const char *fmt, ...) {
+    unsigned long idx = atomic_fetch_add_explicit(&ring_head, 1, memory_order_relaxed);
+    TraceSlot *slot = &ring[idx & (TRACE_RING_SIZE - 1)];
+    va_list ap;
+
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    clock_gettime(CLOCK_REALTIME, &slot->time);
+    slot->level = level;
+    va_start(ap, fmt);
+    vsnprintf(slot->msg, sizeof(slot->msg), fmt, ap);
+    va_end(ap);
+    atomic_store_explicit(&slot->seq, idx + 1, memory_order_release);
+}
+
+/* Write the buffered events to 'fd', returns the number written or -1 */
+int trace_dump(int fd) {
+    return dump_ring(fd);
+}
+
+void trace_clear(void) {
+    for (int k = 0; k < TRACE_RING_SIZE; k++) {
+        atomic_store_explicit(&ring[k].seq, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&ring_head, 0, memory_order_release);
+}
+
+unsigned long trace_event_count(void) {
+    return atomic_load_explicit(&ring_head, memory_order_relaxed);
+}
+
+/* Map "off", "error", "info", "debug" or a digit to a level, -1 if unknown */
+int trace_level_from_name(const char *name) {
+    for (int k = TRACE_OFF; k <= TRACE_DEBUG; k++) {
+        if (strcmp(name, level_names[k]) == 0) {
+            return k;
+        }
+    }
+    if (name[0] >= '0' && name[0] <= '3' && name[1] == '\0') {
+        return name[0] - '0';
+    }
+    return -1;
+}
+
+const char *trace_level_name(int level) {
+    return level_names[level];
+}
@@ -0,0 +1,40 @@
+/*
+Author: Assem Samy
+File: trace.h
+Comment: Tracing layer, events are kept in an in-memory ring buffer instead of being printed
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+/*----------------macros declarations-----------------*/
+#define TRACE_OFF    0
+#define TRACE_ERROR  1
+#define TRACE_INFO   2
+#define TRACE_DEBUG  3
+
+// Tracepoints above this level are removed by the compiler (build with -DTRACE_COMPILE_LEVEL=0 to drop all)
+#ifndef TRACE_COMPILE_LEVEL
+#define TRACE_COMPILE_LEVEL TRACE_DEBUG
+#endif
+
+#define TRACE_RING_SIZE 4096   // Number of events kept, power of two
+#define TRACE_MSG_SIZE  112    // Bytes of formatted text kept per event
+
+/* A disabled tracepoint costs one predictable, not-taken branch on trace_level */
+#define TRACE(level, ...)                                                        \
+    do {                                                                         \
+        if ((level) <= TRACE_COMPILE_LEVEL && __builtin_expect((level) <= trace_level, 0)) { \
+            trace_event((level), __VA_ARGS__);                                   \
+        }                                                                        \
+    } while (0)
+/*-----------------extern variables------------------*/
+extern int trace_level;   // Runtime level, events above it are skipped
+/*-----------section contains functions declarations------------*/
+void trace_init(void);
+void trace_event(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+int trace_dump(int fd);
+void trace_clear(void);
+unsigned long trace_event_count(void);
+int trace_level_from_name(const char *name);
+const char *trace_level_name(int level);
+#endif
@@ -0,0 +1,447 @@
+/*
+Author: Assem Samy
+File: uringcopy.c
+Comment: Copies many small files through one io_uring, open/read/write/close of each file are one linked chain
+*/
+
+/*-----------------Includes Section--------------*/
+#include "commands.h"
+#include "uringcopy.h"
+#include "trace.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/*-----------------types and static functions---------------*/
+
+/* The two rings shared with the kernel, mapped once per batch (no liburing) */
+typedef struct {
+    int fd;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned to_submit;     // SQEs queued since the last io_uring_enter
+} Ring;
+
+/* One file in flight: its two chains of requests, its buffer and its temporary name */
+typedef struct {
+    int file;               // Index into the sources
+    int remaining;          // Completions still expected for the current chain
+    int writing;            // 0: open, open, read. 1: write, close, close
+    int active;             // A file is in flight, its temporary name may exist
+    int failed;
+    int length;             // Bytes the read returned
+    char *buffer;
+    char temp_name[NAME_MAX + 1];
+} UringSlot;
+
+static unsigned int temp_counter;   // Makes temporary names unique within this process
+
+static int ring_setup(Ring *ring, unsigned entries) {
+    struct io_uring_params p;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&p, 0, sizeof(p));
+    ring->fd = (int)syscall(SYS_io_uring_setup, entries, &p);
+    if (ring->fd == -1) {
+        return -1;  // ENOSYS on old kernels, EPERM when kernel.io_uring_disabled is set
+    }
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        close(ring->fd);
+        return -1;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_ring_size);
+            close(ring->fd);
+            return -1;
+        }
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ring != ring->sq_ring) {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(ring->fd);
+        return -1;
+    }
+
+    char *sq = ring->sq_ring;
+    char *cq = ring->cq_ring;
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->sq_entries = p.sq_entries;
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+static void ring_free(Ring *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);  // Also closes every fixed file still registered
+}
+
+/* Check the kernel knows every opcode of the chain */
+static int ring_supports_copy(Ring *ring) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    int ops[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE, IORING_OP_STATX};
+    int ok = 0;
+
+    if (probe != NULL && syscall(SYS_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+        ok = 1;
+        for (size_t k = 0; k < sizeof(ops) / sizeof(ops[0]); k++) {
+            if (ops[k] > probe->last_op || !(probe->ops[ops[k]].flags & IO_URING_OP_SUPPORTED)) {
+                ok = 0;
+            }
+        }
+    }
+    free(probe);
+    return ok;
+}
+
+/* Next free SQE, zeroed. The caller never queues more than sq_entries between submits. */
+static struct io_uring_sqe *ring_get_sqe(Ring *ring) {
+    unsigned tail = *ring->sq_tail + ring->to_submit;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->to_submit++;
+    return sqe;
+}
+
+/* Publish the queued SQEs and wait for at least 'wait' completions */
+static int ring_submit(Ring *ring, unsigned wait) {
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->to_submit, __ATOMIC_RELEASE);
+    unsigned submit = ring->to_submit;
+    ring->to_submit = 0;
+
+    while (1) {
+        long n = syscall(SYS_io_uring_enter, ring->fd, submit, wait, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (n >= 0) {
+            return 0;
+        }
+        if (errno != EINTR) {
+            return -1;
+        }
+        submit = 0;  // Already consumed by the kernel before the signal
+    }
+}
+
+/* Phase 1: statx every source and its destination in batches. Small regular files
+ * whose destination does not exist yet are eligible: replacing a file keeps its owner,
+ * attributes and hard links, which is copy_file()'s job.
+ */
+static int stat_sources(Ring *ring, char **sources, int count, int dst_dir_fd, const char **dst_names, char *eligible) {
+    struct statx *stx = malloc(ring->sq_entries * sizeof(struct statx));
+    int per_batch = (int)ring->sq_entries / 2;
+    if (stx == NULL) {
+        return -1;
+    }
+
+    for (int first = 0; first < count; first += per_batch) {
+        int batch = count - first < per_batch ? count - first : per_batch;
+        for (int k = 0; k < batch; k++) {
+            struct io_uring_sqe *sqe = ring_get_sqe(ring);
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (unsigned long)sources[first + k];
+            sqe->len = STATX_TYPE | STATX_SIZE;
+            sqe->off = (unsigned long)&stx[2 * k];
+            sqe->user_data = 2 * k;
+
+            sqe = ring_get_sqe(ring);
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = dst_dir_fd;
+            sqe->addr = (unsigned long)dst_names[first + k];
+            sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+            sqe->len = STATX_TYPE;
+            sqe->off = (unsigned long)&stx[2 * k + 1];
+            sqe->user_data = 2 * k + 1;
+            eligible[first + k] = 1;   // Until one of the two checks fails
+        }
+        if (ring_submit(ring, 2 * batch) == -1) {
+            free(stx);
+            return -1;
+        }
+
+        int seen = 0;
+        while (seen < 2 * batch) {
+            unsigned head = *ring->cq_head;
+            unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+            if (head == tail) {
+                if (ring_submit(ring, 1) == -1) {
+                    free(stx);
+                    return -1;
+                }
+                continue;
+            }
+            for (; head != tail; head++, seen++) {
+                struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+                int k = (int)(cqe->user_data / 2);
+                const struct statx *st = &stx[cqe->user_data];
+                // The whole file must fit in the buffer with room to spare, see the read in queue_open()
+                int ok = (cqe->user_data % 2 == 0)
+                             ? cqe->res == 0 && S_ISREG(st->stx_mode) && st->stx_size < URING_COPY_MAX_FILE
+                             : cqe->res == -ENOENT;
+                if (!ok) {
+                    eligible[first + k] = 0;
+                }
+            }
+            __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        }
+    }
+    free(stx);
+    return 0;
+}
+
+/* First chain of one file in slot 's' (fixed-file slots 2s and 2s+1): open the source,
+ * create a hidden temporary file next to the destination, and read the source into the
+ * whole buffer. The read length is not the statx size, so a file that grew since is
+ * read up to the buffer's end and caught by the full buffer. A failure cancels the rest
+ * of the chain. Returns -1 if the temporary name does not fit, nothing is queued then.
+ */
+static int queue_open(Ring *ring, UringSlot *slot, int s, char **sources, int dst_dir_fd, const char **dst_names) {
+    struct io_uring_sqe *sqe;
+    unsigned src_slot = 2 * s;
+    unsigned dst_slot = 2 * s + 1;
+    unsigned long tag = (unsigned long)s * URING_COPY_OPS;
+
+    // Same pattern as atomicfile.c, so the leftovers of a crash look the same
+    unsigned int n = __atomic_add_fetch(&temp_counter, 1, __ATOMIC_RELAXED);
+    if (snprintf(slot->temp_name, sizeof(slot->temp_name), ".%s.uring-%d-%u", dst_names[slot->file], (int)getpid(),
+                 n) >= (int)sizeof(slot->temp_name)) {
+        return -1;
+    }
+    slot->remaining = 3;
+    slot->writing = 0;
+    slot->failed = 0;
+
+    sqe = ring_get_sqe(ring);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (unsigned long)sources[slot->file];
+    sqe->open_flags = O_RDONLY;
+    sqe->file_index = src_slot + 1;  // Direct descriptor, never enters the fd table
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = tag;
+
+    sqe = ring_get_sqe(ring);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = dst_dir_fd;
+    sqe->addr = (unsigned long)slot->temp_name;
+    sqe->open_flags = O_WRONLY | O_CREAT | O_EXCL;
+    sqe->len = 0666;                 // Like copy_file() for a new file, the umask applies
+    sqe->file_index = dst_slot + 1;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = tag + 1;
+
+    sqe = ring_get_sqe(ring);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = src_slot;
+    sqe->addr = (unsigned long)slot->buffer;
+    sqe->len = URING_COPY_MAX_FILE;
+    sqe->off = 0;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->user_data = tag + 2;
+    return 0;
+}
+
+/* Second chain, once the read is in: write what was read (skipped after a failure) and
+ * close both slots, the closes run whatever happened before them
+ */
+static void queue_write(Ring *ring, UringSlot *slot, int s) {
+    struct io_uring_sqe *sqe;
+    unsigned src_slot = 2 * s;
+    unsigned dst_slot = 2 * s + 1;
+    unsigned long tag = (unsigned long)s * URING_COPY_OPS;
+
+    slot->remaining = 2;
+    slot->writing = 1;
+    if (!slot->failed) {
+        sqe = ring_get_sqe(ring);
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = dst_slot;
+        sqe->addr = (unsigned long)slot->buffer;
+        sqe->len = slot->length;
+        sqe->off = 0;
+        sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+        sqe->user_data = tag + 3;
+        slot->remaining++;
+    }
+
+    sqe = ring_get_sqe(ring);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = src_slot + 1;
+    sqe->flags = IOSQE_IO_HARDLINK;
+    sqe->user_data = tag + 4;
+
+    sqe = ring_get_sqe(ring);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = dst_slot + 1;
+    sqe->user_data = tag + 5;
+}
+
+/* Start the next eligible file in slot 's'. Returns 1 if one was queued, 0 if none is left */
+static int start_next(Ring *ring, UringSlot *slot, int s, char **sources, int count, int dst_dir_fd, const char **dst_names,
+                      const char *eligible, int *next) {
+    while (*next < count) {
+        slot->file = (*next)++;
+        if (eligible[slot->file] && queue_open(ring, slot, s, sources, dst_dir_fd, dst_names) == 0) {
+            slot->active = 1;
+            return 1;
+        }
+    }
+    slot->active = 0;
+    return 0;
+}
+
+/*-----------Section Contains Function Definitions------------*/
+
+/* Copy sources[k] to dst_names[k] inside the directory dst_dir_fd, for every small
+ * regular file whose destination does not exist yet, with at most URING_COPY_DEPTH
+ * files in flight in one io_uring. Each file is written under a hidden temporary name
+ * and renamed to its own with RENAME_NOREPLACE once complete, so a crash never leaves a
+ * partial file under the real name. done[k] is set for each file copied; anything else
+ * (large files, existing destinations, directories, errors) is left to the caller's
+ * regular copy path, which also reports the errors.
+ * Returns the number of files copied, or -1 if io_uring cannot be used at all.
+ */
+int uring_copy_batch(char **sources, int count, int dst_dir_fd, const char **dst_names, char *done) {
+    Ring ring;
+    unsigned entries = URING_COPY_DEPTH * URING_COPY_OPS;
+    int copied = 0;
+
+    memset(done, 0, count);
+    if (ring_setup(&ring, entries) == -1) {
+        TRACE(TRACE_INFO, "io_uring unavailable (%s), copying file by file", strerror(errno));
+        return -1;
+    }
+    if (!ring_supports_copy(&ring)) {
+        TRACE(TRACE_INFO, "io_uring lacks open/close/statx, copying file by file");
+        ring_free(&ring);
+        return -1;
+    }
+
+    // Empty slots, the chains open straight into them
+    int fixed[2 * URING_COPY_DEPTH];
+    memset(fixed, -1, sizeof(fixed));
+    char *eligible = calloc(count, 1);
+    char *buffers = malloc((size_t)URING_COPY_DEPTH * URING_COPY_MAX_FILE);
+    if (eligible == NULL || buffers == NULL ||
+        syscall(SYS_io_uring_register, ring.fd, IORING_REGISTER_FILES, fixed, 2 * URING_COPY_DEPTH) == -1 ||
+        stat_sources(&ring, sources, count, dst_dir_fd, dst_names, eligible) == -1) {
+        TRACE(TRACE_INFO, "io_uring setup failed (%s), copying file by file", strerror(errno));
+        free(eligible);
+        free(buffers);
+        ring_free(&ring);
+        return -1;
+    }
+
+    UringSlot slots[URING_COPY_DEPTH];
+    int next = 0;
+    int inflight = 0;
+
+    for (int s = 0; s < URING_COPY_DEPTH; s++) {
+        slots[s].buffer = buffers + (size_t)s * URING_COPY_MAX_FILE;
+        slots[s].active = 0;
+        if (start_next(&ring, &slots[s], s, sources, count, dst_dir_fd, dst_names, eligible, &next)) {
+            inflight++;
+        }
+    }
+
+    while (inflight > 0) {
+        if (ring_submit(&ring, 1) == -1) {
+            break;  // The files still in flight are redone by the regular path
+        }
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+            int s = (int)(cqe->user_data / URING_COPY_OPS);
+            int op = (int)(cqe->user_data % URING_COPY_OPS);
+            UringSlot *slot = &slots[s];
+
+            if (cqe->res < 0) {
+                slot->failed = 1;
+            } else if (op == 2) {
+                // A full buffer may hold only the start of a file that grew, copy_file() takes it
+                slot->length = cqe->res;
+                slot->failed |= cqe->res >= URING_COPY_MAX_FILE;
+            } else if (op == 3 && cqe->res != slot->length) {
+                slot->failed = 1;
+            }
+            if (--slot->remaining > 0) {
+                continue;
+            }
+            if (!slot->writing) {
+                queue_write(&ring, slot, s);
+                continue;
+            }
+
+            // Both chains completed: publish the file, or drop the temporary one
+            if (!slot->failed &&
+                renameat2(dst_dir_fd, slot->temp_name, dst_dir_fd, dst_names[slot->file], RENAME_NOREPLACE) == 0) {
+                done[slot->file] = 1;
+                copied++;
+            } else {
+                unlinkat(dst_dir_fd, slot->temp_name, 0);
+            }
+            inflight--;
+            if (start_next(&ring, slot, s, sources, count, dst_dir_fd, dst_names, eligible, &next)) {
+                inflight++;
+            }
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    TRACE(TRACE_INFO, "io_uring copied %d of %d files", copied, count);
+    free(eligible);
+    free(buffers);
+    ring_free(&ring);
+    // Only after a failed submit: those files are left to the regular path, their temporary ones go
+    for (int s = 0; s < URING_COPY_DEPTH; s++) {
+        if (slots[s].active) {
+            unlinkat(dst_dir_fd, slots[s].temp_name, 0);
+        }
+    }
+    return copied;
+}
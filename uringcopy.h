@@ -0,0 +1,18 @@
+/*
+Author: Assem Samy
+File: uringcopy.h
+Comment: Batched small-file copy over io_uring (raw syscalls), used by mycp for many sources at once
+*/
+
+#ifndef URINGCOPY_H
+#define URINGCOPY_H
+/*-----------------includes section--------------*/
+#include <sys/types.h>
+/*----------------macros declarations-----------------*/
+#define URING_COPY_DEPTH      64            // Files in flight at once, each one owns a buffer and two fixed-file slots
+#define URING_COPY_MAX_FILE   (64 * 1024)   // Read buffer per file, files this large or larger take the regular copy path
+#define URING_COPY_MIN_FILES  8             // Fewer sources are not worth setting up a ring
+#define URING_COPY_OPS        6             // open src, open temp, read, then write, close src, close temp
+/*-----------section contains functions declarations------------*/
+int uring_copy_batch(char **sources, int count, int dst_dir_fd, const char **dst_names, char *done);
+#endif